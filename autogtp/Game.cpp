@@ -19,16 +19,14 @@
 #include <QUuid>
 #include "Game.h"
 
-Game::Game(const QString& weights, QTextStream& out) :
+Game::Game(const QString& weights, QTextStream& out, bool verbose) :
     QProcess(),
     output(out),
     cmdLine("./leelaz"),
-    timeSettings("time_settings 0 1 0"),
-    resignation(false),
-    blackToMove(true),
-    blackResigned(false),
-    passes(0),
-    moveNum(0)
+    weightsName(weights),
+    state(State::VERSION),
+    verbose(verbose),
+    success(false)
 {
 #ifdef WIN32
     cmdLine.append(".exe");
@@ -36,7 +34,17 @@ Game::Game(const QString& weights, QTextStream& out) :
     cmdLine.append(" -g -q -n -d -m 30 -r 0 -w ");
     cmdLine.append(weights);
     cmdLine.append(" -p 1000 --noponder");
-    fileName = QUuid::createUuid().toRfc4122().toHex();
+    baseName = QUuid::createUuid().toRfc4122().toHex();
+    // The engine names the first game of a selfplay command
+    // <basename>_0.sgf and <basename>_0.txt.0.gz.
+    fileName = baseName + "_0";
+
+    connect(this, &QProcess::readyReadStandardOutput,
+            this, &Game::engineOutput);
+    connect(this, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>
+                      (&QProcess::finished),
+            this, &Game::engineFinished);
+    connect(this, &QProcess::errorOccurred, this, &Game::engineError);
 }
 
 void Game::error(int errnum) {
@@ -60,213 +68,128 @@ void Game::error(int errnum) {
     }
 }
 
-bool Game::eatNewLine() {
-    char readBuffer[256];
-    // Eat double newline from GTP protocol
-    if (!waitReady()) {
-        error(Game::PROCESS_DIED);
-        return false;
-    }
-    auto readCount = readLine(readBuffer, 256);
-    if(readCount < 0) {
-        error(Game::WRONG_GTP);
-        return false;
-    }
-    return true;
-}
-
-bool Game::sendGtpCommand(QString cmd) {
+void Game::sendGtpCommand(State next, QString cmd) {
+    state = next;
     write(qPrintable(cmd.append("\n")));
-    waitForBytesWritten(-1);
-    if (!waitReady()) {
-        error(Game::PROCESS_DIED);
-        return false;
-    }
-    char readBuffer[256];
-    int readCount = readLine(readBuffer, 256);
-    if (readCount <= 0 || readBuffer[0] != '=') {
-        output << "GTP: " << readBuffer << endl;
-        error(Game::WRONG_GTP);
-    }
-    if (!eatNewLine()) {
-        return false;
-    }
-    return true;
 }
 
-void Game::checkVersion(const VersionTuple &min_version) {
-    write(qPrintable("version\n"));
-    waitForBytesWritten(-1);
-    if (!waitReady()) {
-        error(Game::LAUNCH_FAILURE);
-        exit(EXIT_FAILURE);
-    }
-    char readBuffer[256];
-    int readCount = readLine(readBuffer, 256);
-    // We expect to read at last "=, space, something"
-    if (readCount <= 3 || readBuffer[0] != '=') {
-        output << "GTP: " << readBuffer << endl;
-        error(Game::WRONG_GTP);
-        exit(EXIT_FAILURE);
-    }
-    QString version_buff(&readBuffer[2]);
-    version_buff = version_buff.simplified();
-    QStringList version_list = version_buff.split(".");
-    if (version_list.size() < 2) {
-        output << "Unexpected Leela Zero version: " << version_buff << endl;
-        exit(EXIT_FAILURE);
-    }
-    if (version_list[0].toInt() < std::get<0>(min_version)
-        || (version_list[0].toInt() == std::get<0>(min_version)
-           && version_list[1].toInt() < std::get<1>(min_version))) {
-        output << "Leela version is too old, saw " << version_buff
-               << " but expected "
-               << std::get<0>(min_version) << "."
-               << std::get<1>(min_version) << "." << endl;
-        output << "Check https://github.com/gcp/leela-zero for updates."
-                << endl;
-        exit(EXIT_FAILURE);
-    }
-    if (!eatNewLine()) {
-        error(Game::WRONG_GTP);
-        exit(EXIT_FAILURE);
+void Game::engineOutput() {
+    while (canReadLine()) {
+        auto line = QString(readLine()).trimmed();
+        if (response.isEmpty()) {
+            // Skip blank lines between responses
+            response = line;
+        } else if (line.isEmpty()) {
+            // GTP responses end with an empty line
+            auto resp = response;
+            response.clear();
+            handleResponse(resp);
+        }
     }
 }
 
-bool Game::gameStart(const VersionTuple &min_version) {
-    start(cmdLine);
-    if(!waitForStarted()) {
-        error(Game::NO_LEELAZ);
-        return false;
+void Game::engineFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+    Q_UNUSED(exitCode);
+    Q_UNUSED(exitStatus);
+    // somebody crashed
+    if (state != State::QUIT) {
+        error(state == State::VERSION ? Game::LAUNCH_FAILURE
+                                      : Game::PROCESS_DIED);
+        success = false;
     }
-    output << "Engine has started." << endl;
-    // This either succeeds or we exit immediately, so no need to
-    // check any return values.
-    checkVersion(min_version);
-    sendGtpCommand(timeSettings);
-    output << "Infinite thinking time set." << endl;
-    return true;
+    emit gameFinished(success);
 }
 
-void Game::move() {
-    moveNum++;
-    QString moveCmd;
-    if (blackToMove) {
-        moveCmd = "genmove b\n";
-    } else {
-        moveCmd = "genmove w\n";
+void Game::engineError(QProcess::ProcessError processError) {
+    // A process that did start reports its end through finished().
+    if (processError == QProcess::FailedToStart) {
+        error(Game::NO_LEELAZ);
+        emit gameFinished(false);
     }
-    write(qPrintable(moveCmd));
-    waitForBytesWritten(-1);
 }
 
-bool Game::waitReady() {
-    while (!canReadLine() && state() == QProcess::Running) {
-        waitForReadyRead(-1);
+void Game::handleResponse(const QString& resp) {
+    if (state == State::QUIT) {
+        return;
     }
-    // somebody crashed
-    if (state() != QProcess::Running) {
-        return false;
+    if (resp.isEmpty() || resp[0] != '=') {
+        output << "GTP: " << resp << endl;
+        error(Game::WRONG_GTP);
+        if (state == State::VERSION) {
+            exit(EXIT_FAILURE);
+        }
+        gameQuit();
+        return;
+    }
+    switch (state) {
+        case State::VERSION:
+            // This either succeeds or we exit immediately.
+            if (!checkVersion(resp)) {
+                exit(EXIT_FAILURE);
+            }
+            selfPlay();
+            break;
+        case State::SELFPLAY:
+            if (verbose) {
+                output << "Game has ended, wrote " << fileName
+                       << ".sgf" << endl;
+            }
+            success = true;
+            gameQuit();
+            break;
+        case State::QUIT:
+            break;
     }
-    return true;
 }
 
-bool Game::readMove() {
-    char readBuffer[256];
-    int readCount = readLine(readBuffer, 256);
-    if (readCount <= 3 || readBuffer[0] != '=') {
+bool Game::checkVersion(const QString& resp) {
+    // We expect to read at last "=, space, something"
+    if (resp.size() <= 2) {
+        output << "GTP: " << resp << endl;
         error(Game::WRONG_GTP);
-        output << "Error read " << readCount << " '";
-        output << readBuffer << "'" << endl;
-        terminate();
         return false;
     }
-    // Skip "= "
-    QString moveDone = readBuffer;
-    moveDone.remove(0, 2);
-    moveDone = moveDone.simplified();
-    if (!eatNewLine()) {
+    QString version_buff = resp.mid(2).simplified();
+    QStringList version_list = version_buff.split(".");
+    if (version_list.size() < 2) {
+        output << "Unexpected Leela Zero version: " << version_buff << endl;
         return false;
     }
-    output << moveNum << " (" << moveDone << ") ";
-    output.flush();
-    if (moveDone.compare(QStringLiteral("pass"),
-                          Qt::CaseInsensitive) == 0) {
-        passes++;
-    } else if (moveDone.compare(QStringLiteral("resign"),
-                                 Qt::CaseInsensitive) == 0) {
-        resignation = true;
-        blackResigned = blackToMove;
-    } else {
-        passes = 0;
-    }
-    return true;
-}
-
-bool Game::nextMove() {
-    if(resignation || passes > 1 || moveNum > (19 * 19 * 2)) {
+    if (version_list[0].toInt() < std::get<0>(minVersion)
+        || (version_list[0].toInt() == std::get<0>(minVersion)
+           && version_list[1].toInt() < std::get<1>(minVersion))) {
+        output << "Leela version is too old, saw " << version_buff
+               << " but expected "
+               << std::get<0>(minVersion) << "."
+               << std::get<1>(minVersion) << "." << endl;
+        output << "Check https://github.com/gcp/leela-zero for updates."
+                << endl;
         return false;
     }
-    blackToMove = !blackToMove;
     return true;
 }
 
-bool Game::getScore() {
-    if(resignation) {
-        if (blackResigned) {
-            winner = QString(QStringLiteral("white"));
-        } else {
-            winner = QString(QStringLiteral("black"));
+void Game::gameStart(const VersionTuple &min_version) {
+    minVersion = min_version;
+    connect(this, &QProcess::started, this, [this]() {
+        if (verbose) {
+            output << "Engine has started." << endl;
         }
-    } else{
-        write("final_score\n");
-        waitForBytesWritten(-1);
-        if (!waitReady()) {
-            error(Game::PROCESS_DIED);
-            return false;
-        }
-        char readBuffer[256];
-        readLine(readBuffer, 256);
-        QString score = readBuffer;
-        score.remove(0, 2);
-        if (readBuffer[2] == 'W') {
-            winner = QString(QStringLiteral("white"));
-        } else if (readBuffer[2] == 'B') {
-            winner = QString(QStringLiteral("black"));
-        }
-        if (!eatNewLine()) {
-            return false;
-        }
-        output << "Score: " << score;
-    }
-    if (winner.isNull()) {
-        output << "No winner found" << endl;
-        return false;
-    }
-    output << "Winner: " << winner << endl;
-    return true;
-}
-
-bool Game::writeSgf() {
-    output << "Writing " << fileName + ".sgf" << endl;
-
-    if (!sendGtpCommand(qPrintable("printsgf " + fileName + ".sgf"))) {
-        return false;
-    }
-    return true;
+        sendGtpCommand(State::VERSION, "version");
+    });
+    start(cmdLine);
 }
 
-bool Game::dumpTraining() {
-    output << "Dumping " << fileName + ".txt" << endl;
-
-    if (!sendGtpCommand(qPrintable("dump_training " + winner +
-                        " " + fileName + ".txt"))) {
-        return false;
+void Game::selfPlay() {
+    if (verbose) {
+        output << "Playing the game." << endl;
     }
-    return true;
+    sendGtpCommand(State::SELFPLAY, "selfplay 1 " + baseName);
 }
 
 void Game::gameQuit() {
-    write(qPrintable("quit\n"));
-    waitForFinished(-1);
+    if (verbose) {
+        output << "Stopping engine." << endl;
+    }
+    sendGtpCommand(State::QUIT, "quit");
 }
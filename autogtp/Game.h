@@ -25,19 +25,25 @@
 
 using VersionTuple = std::tuple<int, int>;
 
-class Game : QProcess {
+/*
+    Plays one self-play game in a leelaz process. The engine plays the
+    whole game with its selfplay command and writes the SGF and
+    training data itself. Every GTP response sends the next command,
+    so many games can run side by side in one event loop.
+*/
+class Game : public QProcess {
+    Q_OBJECT
 public:
-    Game(const QString& weights, QTextStream& out);
+    Game(const QString& weights, QTextStream& out, bool verbose = true);
     ~Game() = default;
-    bool gameStart(const VersionTuple& min_version);
-    void move();
-    bool waitForMove() { return waitReady(); }
-    bool readMove();
-    bool nextMove();
-    bool getScore();
-    bool writeSgf();
-    bool dumpTraining();
-    void gameQuit();
+    void gameStart(const VersionTuple& min_version);
+    QString getFile() const { return fileName; }
+    QString getWeights() const { return weightsName; }
+
+signals:
+    // The engine has quit. On success the SGF and training
+    // data of the game have been written.
+    void gameFinished(bool success);
 
 private:
     enum {
@@ -46,21 +52,30 @@ private:
         WRONG_GTP,
         LAUNCH_FAILURE
     };
+    enum class State {
+        VERSION,
+        SELFPLAY,
+        QUIT
+    };
 
     QTextStream& output;
     QString cmdLine;
-    QString timeSettings;
-    QString winner;
+    QString baseName;
     QString fileName;
-    bool resignation;
-    bool blackToMove;
-    bool blackResigned;
-    int passes;
-    int moveNum;
-    bool sendGtpCommand(QString cmd);
-    void checkVersion(const VersionTuple &min_version);
-    bool waitReady();
-    bool eatNewLine();
+    QString weightsName;
+    QString response;
+    VersionTuple minVersion;
+    State state;
+    bool verbose;
+    bool success;
+    void engineOutput();
+    void engineFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void engineError(QProcess::ProcessError processError);
+    void handleResponse(const QString& resp);
+    void sendGtpCommand(State next, QString cmd);
+    bool checkVersion(const QString& resp);
+    void selfPlay();
+    void gameQuit();
     void error(int errnum);
 };
 
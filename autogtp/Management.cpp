@@ -0,0 +1,280 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <QProcess>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <functional>
+#include "Management.h"
+
+/*
+    Runs cmdline without blocking the event loop and calls done
+    once it has exited, or failed to start at all.
+*/
+static void run_async(QObject* parent, const QString& cmdline,
+                      std::function<void(QProcess&)> done) {
+    auto proc = new QProcess(parent);
+    auto finish = [proc, done]() {
+        done(*proc);
+        proc->deleteLater();
+    };
+    QObject::connect(proc,
+        static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>
+            (&QProcess::finished),
+        parent, [finish](int, QProcess::ExitStatus) { finish(); });
+    QObject::connect(proc, &QProcess::errorOccurred, parent,
+        [finish](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                finish();
+            }
+        });
+    proc->start(cmdline);
+}
+
+Management::Management(int games, const QString& keepPath,
+                       QTextStream& out, QObject* parent) :
+    QObject(parent),
+    output(out),
+    keepPath(keepPath),
+    games(games),
+    gamesRunning(0),
+    gamesWaiting(0),
+    gamesPlayed(0),
+    uploading(false),
+    fetching(false),
+    failed(false)
+{
+}
+
+void Management::start() {
+    startTime = Clock::now();
+    for (int i = 0; i < games && !failed; i++) {
+        startGame();
+    }
+}
+
+void Management::startGame() {
+    gamesWaiting++;
+    fetchNetwork();
+}
+
+/*
+    Look up the best network and download it if needed, then start
+    every game waiting for it. Games that want to start meanwhile
+    wait for the same lookup.
+*/
+void Management::fetchNetwork() {
+    if (fetching) {
+        return;
+    }
+    fetching = true;
+    fetchBestNetworkHash([this](const QString& nethash) {
+        fetchBestNetwork(nethash, [this](const QString& netname) {
+            fetching = false;
+            while (gamesWaiting > 0 && !failed) {
+                gamesWaiting--;
+                launchGame(netname);
+            }
+            gamesWaiting = 0;
+            checkDone();
+        });
+    });
+}
+
+void Management::launchGame(const QString& netname) {
+    // With several games running at once their progress messages
+    // would get mixed up, so only a single game prints them.
+    auto game = new Game(netname, output, games == 1);
+    auto gameStart = Clock::now();
+    connect(game, &Game::gameFinished, this,
+            [this, game, gameStart](bool success) {
+                gameFinished(game, success, gameStart);
+            });
+    gamesRunning++;
+    game->gameStart(min_leelaz_version);
+}
+
+void Management::gameFinished(Game* game, bool success,
+                              Clock::time_point gameStart) {
+    game->deleteLater();
+    gamesRunning--;
+    if (games > 1) {
+        output << "Game " << game->getFile()
+               << (success ? " has ended." : " failed.") << endl;
+    }
+    if (success) {
+        gamesPlayed++;
+        printTimingInfo(gameStart);
+        uploads.enqueue({game->getFile(), game->getWeights()});
+        uploadNext();
+    } else {
+        failed = true;
+    }
+    if (!failed) {
+        startGame();
+    }
+    checkDone();
+}
+
+/*
+    Stop once a failure has let all games and uploads run out.
+*/
+void Management::checkDone() {
+    if (failed && gamesRunning == 0 && !fetching
+        && !uploading && uploads.isEmpty()) {
+        QCoreApplication::exit(EXIT_FAILURE);
+    }
+}
+
+void Management::uploadNext() {
+    if (uploading || uploads.isEmpty()) {
+        return;
+    }
+    uploading = true;
+    uploadGame(uploads.dequeue());
+}
+
+void Management::uploadGame(const Upload& upload) {
+    QString sgf_file = upload.file + ".sgf";
+    QString data_file = upload.file + ".txt.0.gz";
+    // Save first if requested
+    if (!keepPath.isEmpty()) {
+        QFile(sgf_file).copy(keepPath + '/' + sgf_file);
+    }
+    // Gzip up the sgf too
+#ifdef WIN32
+    QString gzip_cmdline("gzip.exe " + sgf_file);
+#else
+    QString gzip_cmdline("gzip " + sgf_file);
+#endif
+    run_async(this, gzip_cmdline, [this, upload, sgf_file, data_file](QProcess&) {
+        QString sgf_gz = sgf_file + ".gz";
+        QString prog_cmdline("curl");
+#ifdef WIN32
+        prog_cmdline.append(".exe");
+#endif
+        prog_cmdline.append(" -F networkhash=" + upload.netname);
+        prog_cmdline.append(" -F clientversion=" + QString::number(AUTOGTP_VERSION));
+        prog_cmdline.append(" -F sgf=@" + sgf_gz);
+        prog_cmdline.append(" -F trainingdata=@" + data_file);
+        prog_cmdline.append(" http://zero.sjeng.org/submit");
+        output << prog_cmdline << endl;
+        run_async(this, prog_cmdline, [this, sgf_gz, data_file](QProcess& curl) {
+            QByteArray curl_output = curl.readAllStandardOutput();
+            output << QString(curl_output);
+            QDir dir;
+            dir.remove(sgf_gz);
+            dir.remove(data_file);
+            uploading = false;
+            uploadNext();
+            checkDone();
+        });
+    });
+}
+
+void Management::fetchBestNetworkHash(
+    std::function<void(const QString&)> done) {
+    QString prog_cmdline("curl");
+#ifdef WIN32
+    prog_cmdline.append(".exe");
+#endif
+    prog_cmdline.append(" http://zero.sjeng.org/best-network-hash");
+    run_async(this, prog_cmdline, [this, done](QProcess& curl) {
+        QByteArray curl_output = curl.readAllStandardOutput();
+        QString outstr(curl_output);
+        QStringList outlst = outstr.split("\n");
+        if (outlst.size() != 2) {
+            output << "Unexpected output from server: " << endl
+                   << curl_output << endl;
+            exit(EXIT_FAILURE);
+        }
+        QString outhash = outlst[0];
+        QString client_version = outlst[1];
+        auto server_expected = client_version.toInt();
+        if (server_expected > AUTOGTP_VERSION) {
+            output << "Server requires client version " << server_expected
+                   << " but we are version " << AUTOGTP_VERSION << endl;
+            output << "Check https://github.com/gcp/leela-zero for updates." << endl;
+            exit(EXIT_FAILURE);
+        }
+        output << "Best network hash: " << outhash << endl;
+        output << "Required client version: " << server_expected << " (OK)" << endl;
+        done(outhash);
+    });
+}
+
+void Management::fetchBestNetwork(const QString& nethash,
+                                  std::function<void(const QString&)> done) {
+    if (QFileInfo::exists(nethash)) {
+        output << "Already downloaded network." << endl;
+        done(nethash);
+        return;
+    }
+
+    QString prog_cmdline("curl");
+#ifdef WIN32
+    prog_cmdline.append(".exe");
+#endif
+    // Be quiet, but output the real file name we saved to
+    // Use the filename from the server
+    // Resume download if file exists (aka avoid redownloading, and don't
+    // error out if it exists)
+    prog_cmdline.append(" -s -O -J");
+    prog_cmdline.append(" -w %{filename_effective}");
+    prog_cmdline.append(" http://zero.sjeng.org/best-network");
+
+    output << prog_cmdline << endl;
+
+    run_async(this, prog_cmdline, [this, done](QProcess& curl) {
+        QByteArray curl_output = curl.readAllStandardOutput();
+        QString outstr(curl_output);
+        QStringList outlst = outstr.split("\n");
+        QString outfile = outlst[0];
+        output << "Curl filename: " << outfile << endl;
+#ifdef WIN32
+        QString gunzip_cmdline("gzip.exe -d -k -q " + outfile);
+#else
+        QString gunzip_cmdline("gunzip -k -q " + outfile);
+#endif
+        run_async(this, gunzip_cmdline, [this, done, outfile](QProcess&) {
+            // Remove extension (.gz)
+            QString netname = outfile;
+            netname.chop(3);
+            output << "Net filename: " << netname << endl;
+            done(netname);
+        });
+    });
+}
+
+void Management::printTimingInfo(Clock::time_point gameStart) {
+    auto game_end = Clock::now();
+    auto game_time_s =
+        std::chrono::duration_cast<std::chrono::seconds>(game_end - gameStart);
+    auto total_time_s =
+        std::chrono::duration_cast<std::chrono::seconds>(game_end - startTime);
+    auto total_time_min =
+        std::chrono::duration_cast<std::chrono::minutes>(total_time_s);
+    output << gamesPlayed << " game(s) played in "
+           << total_time_min.count() << " minutes = "
+           << total_time_s.count() / gamesPlayed << " seconds/game"
+           << ", last game took "
+           << game_time_s.count() << " seconds." << endl;
+}
@@ -0,0 +1,83 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANAGEMENT_H
+#define MANAGEMENT_H
+
+#include <QObject>
+#include <QQueue>
+#include <QTextStream>
+#include <chrono>
+#include <functional>
+#include "Game.h"
+
+constexpr int AUTOGTP_VERSION = 4;
+
+// Minimal Leela Zero version we expect to see
+const VersionTuple min_leelaz_version{0, 7};
+
+/*
+    Keeps a number of self-play games running and uploads the
+    finished ones. Everything runs from the Qt event loop: games
+    advance on their engine's output, and uploads gzip and send one
+    game at a time while the other games keep playing. The best
+    network is looked up and downloaded the same way, once for all
+    games that are waiting to start.
+*/
+class Management : public QObject {
+    Q_OBJECT
+public:
+    Management(int games, const QString& keepPath,
+               QTextStream& out, QObject* parent = nullptr);
+    ~Management() = default;
+    void start();
+
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Upload {
+        QString file;
+        QString netname;
+    };
+
+    QTextStream& output;
+    QString keepPath;
+    QQueue<Upload> uploads;
+    int games;
+    int gamesRunning;
+    int gamesWaiting;
+    int gamesPlayed;
+    bool uploading;
+    bool fetching;
+    bool failed;
+    Clock::time_point startTime;
+    void startGame();
+    void fetchNetwork();
+    void launchGame(const QString& netname);
+    void gameFinished(Game* game, bool success,
+                      Clock::time_point gameStart);
+    void uploadNext();
+    void uploadGame(const Upload& upload);
+    void checkDone();
+    void fetchBestNetworkHash(std::function<void(const QString&)> done);
+    void fetchBestNetwork(const QString& nethash,
+                          std::function<void(const QString&)> done);
+    void printTimingInfo(Clock::time_point gameStart);
+};
+
+#endif /* MANAGEMENT_H */
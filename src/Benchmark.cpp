@@ -0,0 +1,250 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <boost/format.hpp>
+
+#include "Benchmark.h"
+#include "FastBoard.h"
+#include "GTP.h"
+#include "Network.h"
+#include "SGFTree.h"
+#include "ThreadPool.h"
+#include "UCTSearch.h"
+#include "Utils.h"
+
+using namespace Utils;
+
+/*
+    The empty board, an opening and a crowded middle game.
+*/
+static const char* const s_positions[] = {
+    "(;GM[1]FF[4]SZ[19]KM[7.5])",
+
+    "(;GM[1]FF[4]SZ[19]KM[7.5]"
+    ";B[pc];W[jq];B[qc];W[lc];B[cc];W[dq];B[oq];W[hd];B[cg];W[cq]"
+    ";B[pp];W[qq];B[qr];W[ic];B[jd];W[id];B[jb];W[lb];B[kd];W[hb]"
+    ";B[kc];W[hf];B[ke];W[ib];B[gc];W[ka];B[mg];W[mf];B[kb];W[oh]"
+    ";B[ni];W[ja];B[ph];W[of];B[ia];W[pf];B[ha];W[ga];B[pj];W[nd])",
+
+    "(;GM[1]FF[4]SZ[19]KM[7.5]"
+    ";B[fp];W[dg];B[mp];W[cj];B[kf];W[gq];B[cg];W[jq];B[cd];W[go]"
+    ";B[ch];W[ck];B[fq];W[oc];B[dc];W[dl];B[jn];W[qf];B[iq];W[fj]"
+    ";B[qo];W[ce];B[pe];W[eh];B[df];W[dd];B[ej];W[on];B[dj];W[jo]"
+    ";B[kq];W[ff];B[io];W[cf];B[ci];W[dq];B[lp];W[gp];B[eo];W[jj]"
+    ";B[hf];W[el];B[nr];W[lq];B[ed];W[jc];B[id];W[ph];B[mq];W[ep]"
+    ";B[qq];W[de];B[gr];W[np];B[dk];W[hq];B[cb];W[ln];B[ns];W[jp]"
+    ";B[pm];W[fd];B[mo];W[ko];B[jm];W[hn];B[pg];W[qj];B[hp];W[ng]"
+    ";B[cl];W[ob];B[nd];W[rn];B[pj];W[eq];B[gi];W[nq];B[bh];W[ih]"
+    ";B[dn];W[dh];B[cm];W[pc];B[di];W[en];B[hc];W[qb];B[co];W[il]"
+    ";B[le];W[qd];B[pl];W[pq];B[fh];W[hr];B[gj];W[qe];B[qp];W[dp]"
+    ";B[eg];W[fc];B[fe];W[kd];B[ml];W[fo];B[bb];W[in];B[hh];W[md]"
+    ";B[qn];W[oh];B[ld];W[ni];B[of];W[cc];B[qg];W[or];B[pp];W[pd])",
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start) {
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start);
+    // Never divide by zero, however fast the machine.
+    return std::max(elapsed.count(), 1e-6);
+}
+
+/*
+    Replays every position move by move. SGF loading quietly skips
+    over illegal moves, which would give positions that can't occur
+    in a game.
+*/
+std::vector<GameState> Benchmark::get_positions() {
+    auto positions = std::vector<GameState>{};
+    for (const auto sgf : s_positions) {
+        auto tree = std::make_unique<SGFTree>();
+        tree->load_from_string(sgf);
+        auto state = GameState(tree->get_state());
+        for (auto node = tree->get_child(0); node != nullptr;
+             node = node->get_child(0)) {
+            auto color = state.get_to_move();
+            auto move = node->get_move(color, state.board);
+            if (move == SGFTree::EOT) {
+                continue;
+            }
+            if (move != FastBoard::PASS
+                && (state.board.get_square(move) != FastBoard::EMPTY
+                    || move == state.get_komove()
+                    || state.board.is_suicide(move, color))) {
+                throw std::runtime_error("Illegal move in benchmark position "
+                                         + std::to_string(positions.size()));
+            }
+            state.play_move(color, move);
+        }
+        // Every node but the game's root holds a move.
+        if (state.get_movenum() + 1
+            != static_cast<size_t>(tree->count_mainline_moves())) {
+            throw std::runtime_error("Benchmark position "
+                                     + std::to_string(positions.size())
+                                     + " did not replay completely");
+        }
+        positions.emplace_back(std::move(state));
+    }
+    return positions;
+}
+
+std::vector<int> Benchmark::get_thread_counts(int max_threads) {
+    auto thread_counts = std::vector<int>{};
+    for (auto threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.emplace_back(threads);
+    }
+    thread_counts.emplace_back(max_threads);
+    return thread_counts;
+}
+
+std::string Benchmark::bench_network(const std::vector<GameState> & positions,
+                                     const std::vector<int> & thread_counts) {
+    auto json = std::string{};
+    for (const auto threads : thread_counts) {
+        auto evals_per_thread = (NN_EVALS + threads - 1) / threads;
+        auto start = Clock::now();
+        ThreadGroup tg(thread_pool);
+        for (auto i = 0; i < threads; i++) {
+            tg.add_task([evals_per_thread, i, &positions]() {
+                for (auto eval = 0; eval < evals_per_thread; eval++) {
+                    auto state = positions[(i + eval) % positions.size()];
+                    Network::get_scored_moves(
+                        &state, Network::Ensemble::RANDOM_ROTATION);
+                }
+            });
+        }
+        tg.wait_all();
+        auto seconds = seconds_since(start);
+        auto evals = evals_per_thread * threads;
+
+        json += (json.empty() ? "" : ",");
+        json += boost::str(boost::format(
+            "\n    {\"threads\": %d, \"evaluations\": %d, "
+            "\"seconds\": %.3f, \"evaluations_per_second\": %.1f}")
+            % threads % evals % seconds % (evals / seconds));
+    }
+    return "[" + json + "\n  ]";
+}
+
+std::string Benchmark::bench_board(const std::vector<GameState> & positions) {
+    auto moves = 0;
+    auto start = Clock::now();
+    for (auto round = 0; round < BOARD_ROUNDS; round++) {
+        for (const auto & position : positions) {
+            auto state = position;
+            auto color = state.get_to_move();
+            for (auto y = 0; y < 19; y++) {
+                for (auto x = 0; x < 19; x++) {
+                    auto vertex = state.board.get_vertex(x, y);
+                    if (state.board.get_square(vertex) != FastBoard::EMPTY
+                        || vertex == state.m_komove
+                        || state.board.is_suicide(vertex, color)) {
+                        continue;
+                    }
+                    state.play_move(color, vertex);
+                    state.undo_move();
+                    moves++;
+                }
+            }
+        }
+    }
+    auto seconds = seconds_since(start);
+
+    return boost::str(boost::format(
+        "{\"moves\": %d, \"seconds\": %.3f, \"moves_per_second\": %.1f}")
+        % moves % seconds % (moves / seconds));
+}
+
+std::string Benchmark::bench_search(const std::vector<GameState> & positions,
+                                    const std::vector<int> & thread_counts) {
+    auto json = std::string{};
+    for (const auto threads : thread_counts) {
+        auto totals = UCTSearch::Stats{0, 0, 0, 0, {}};
+        auto max_nodes = 0;
+        auto lookups = uint64{0};
+        auto hits = uint64{0};
+        auto seconds = 0.0;
+        for (const auto & position : positions) {
+            // A new search starts with an empty tree and table.
+            auto state = position;
+            state.set_timecontrol(0, 100, 0, 0);
+            auto search = std::make_unique<UCTSearch>(state);
+            search->set_threads(threads);
+            search->set_playout_limit(SEARCH_PLAYOUTS);
+            search->set_recording(false);
+
+            auto start = Clock::now();
+            search->think(state.get_to_move());
+            seconds += seconds_since(start);
+
+            auto stats = search->get_stats();
+            totals.playouts += stats.playouts;
+            totals.collisions += stats.collisions;
+            totals.wasted += stats.wasted;
+            max_nodes = std::max(max_nodes, stats.nodes);
+            lookups += stats.tt.lookups;
+            hits += stats.tt.hits;
+        }
+
+        json += (json.empty() ? "" : ",");
+        json += boost::str(boost::format(
+            "\n    {\"threads\": %d, \"playouts\": %d, \"seconds\": %.3f, "
+            "\"playouts_per_second\": %.1f, \"collisions\": %d, "
+            "\"wasted_descents\": %d, \"tt_lookups\": %d, \"tt_hits\": %d, "
+            "\"tt_hit_rate\": %.4f, \"max_tree_nodes\": %d, "
+            "\"max_tree_bytes\": %d}")
+            % threads % totals.playouts % seconds
+            % (totals.playouts / seconds) % totals.collisions
+            % totals.wasted % lookups % hits
+            % (lookups ? double(hits) / lookups : 0.0)
+            % max_nodes % (max_nodes * UCTSearch::NODE_MEMORY));
+    }
+    return "[" + json + "\n  ]";
+}
+
+std::string Benchmark::run(int max_threads) {
+    auto positions = get_positions();
+    auto thread_counts = get_thread_counts(std::max(1, max_threads));
+
+    myprintf("Benchmarking %d positions with up to %d thread(s).\n",
+             static_cast<int>(positions.size()), thread_counts.back());
+
+    myprintf("Network...\n");
+    auto network = bench_network(positions, thread_counts);
+    myprintf("Board...\n");
+    auto board = bench_board(positions);
+    myprintf("Search...\n");
+    // Keep the search output out of the results.
+    auto quiet = cfg_quiet;
+    cfg_quiet = true;
+    auto search = bench_search(positions, thread_counts);
+    cfg_quiet = quiet;
+
+    return boost::str(boost::format(
+        "{\n  \"program\": \"%s\",\n  \"version\": \"%s\",\n"
+        "  \"positions\": %d,\n  \"network\": %s,\n"
+        "  \"board\": %s,\n  \"search\": %s\n}\n")
+        % PROGRAM_NAME % PROGRAM_VERSION
+        % positions.size() % network % board % search);
+}
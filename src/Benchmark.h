@@ -0,0 +1,54 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "GameState.h"
+
+class Benchmark {
+public:
+    /*
+        Times the network, the board code and the search on a fixed
+        set of positions, with 1 up to max_threads threads, and
+        returns the results as a JSON object, so that runs on
+        different builds and machines can be compared.
+    */
+    static std::string run(int max_threads);
+
+private:
+    // Network evaluations per thread count, split over the threads.
+    static constexpr int NN_EVALS = 800;
+    // Times every legal move of every position is played and undone.
+    static constexpr int BOARD_ROUNDS = 50;
+    // Playout limit of each search.
+    static constexpr int SEARCH_PLAYOUTS = 1600;
+
+    static std::vector<GameState> get_positions();
+    static std::vector<int> get_thread_counts(int max_threads);
+    static std::string bench_network(const std::vector<GameState> & positions,
+                                     const std::vector<int> & thread_counts);
+    static std::string bench_board(const std::vector<GameState> & positions);
+    static std::string bench_search(const std::vector<GameState> & positions,
+                                    const std::vector<int> & thread_counts);
+};
+
+#endif
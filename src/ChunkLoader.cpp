@@ -0,0 +1,229 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+#include "ChunkLoader.h"
+#include "ChunkLoaderAPI.h"
+#include "Random.h"
+#include "Symmetry.h"
+
+ChunkLoader::ChunkLoader(std::vector<std::string> chunks, size_t batch_size,
+                         int threads, size_t shuffle_size)
+    : m_chunks(std::move(chunks)), m_batch_size(batch_size),
+      m_ring(RING_SIZE) {
+    if (m_chunks.empty() || batch_size == 0 || threads < 1) {
+        throw std::invalid_argument("No chunks or an empty batch");
+    }
+    m_reservoir_size = std::max(size_t{1}, shuffle_size / threads);
+    for (auto& batch : m_ring) {
+        batch.planes.resize(batch_size * PLANES * PLANE_SIZE);
+        batch.probabilities.resize(batch_size * TrainingRecord::PROBABILITIES);
+        batch.results.resize(batch_size);
+    }
+    for (auto i = 0; i < threads; i++) {
+        m_threads.emplace_back(&ChunkLoader::worker, this);
+    }
+}
+
+ChunkLoader::~ChunkLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ChunkLoader::decode(const TrainingRecord& record, int symmetry,
+                         float* planes, float* probabilities, float* result) {
+    for (auto p = size_t{0}; p < TrainingRecord::INPUT_PLANES; p++) {
+        auto out = planes + p * PLANE_SIZE;
+        for (auto idx = 0; idx < Symmetry::NN_SQUARES; idx++) {
+            out[idx] = record.get_bit(p, Symmetry::nn_idx(symmetry, idx));
+        }
+    }
+    // Side to move planes
+    auto white = static_cast<float>(record.get_to_move());
+    auto to_move = planes + TrainingRecord::INPUT_PLANES * PLANE_SIZE;
+    std::fill(to_move, to_move + PLANE_SIZE, 1.0f - white);
+    std::fill(to_move + PLANE_SIZE, to_move + 2 * PLANE_SIZE, white);
+
+    for (auto idx = 0; idx < Symmetry::NN_SQUARES; idx++) {
+        probabilities[idx] =
+            record.get_probability(Symmetry::nn_idx(symmetry, idx));
+    }
+    // Pass maps to itself
+    probabilities[PLANE_SIZE] = record.get_probability(PLANE_SIZE);
+    *result = static_cast<float>(record.get_result());
+}
+
+ChunkLoader::Batch* ChunkLoader::claim_batch() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] {
+        return m_stop || m_ring[m_write % RING_SIZE].state == SlotState::FREE;
+    });
+    if (m_stop) {
+        return nullptr;
+    }
+    auto& batch = m_ring[m_write++ % RING_SIZE];
+    batch.state = SlotState::FILLING;
+    return &batch;
+}
+
+void ChunkLoader::fail(const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error;
+    }
+    m_cv.notify_all();
+}
+
+void ChunkLoader::worker() {
+    auto rng = Random::get_Rng();
+    auto chunks = m_chunks;
+    std::shuffle(begin(chunks), end(chunks), *rng);
+    auto next_chunk = size_t{0};
+    auto records_this_pass = size_t{0};
+    auto reader = std::unique_ptr<TrainingReader>{};
+
+    // Reads the next record, cycling through the chunks forever.
+    auto next_record = [&](TrainingRecord& record) {
+        for (;;) {
+            try {
+                if (reader && reader->read(record)) {
+                    records_this_pass++;
+                    return true;
+                }
+            } catch (const std::exception& e) {
+                fprintf(stderr, "Skipping rest of chunk: %s\n", e.what());
+            }
+            reader.reset();
+            if (next_chunk == chunks.size()) {
+                if (records_this_pass == 0) {
+                    return false;
+                }
+                std::shuffle(begin(chunks), end(chunks), *rng);
+                next_chunk = 0;
+                records_this_pass = 0;
+            }
+            const auto& name = chunks[next_chunk++];
+            try {
+                reader = std::make_unique<TrainingReader>(name);
+            } catch (const std::exception& e) {
+                fprintf(stderr, "Skipping %s: %s\n", name.c_str(), e.what());
+            }
+        }
+    };
+
+    auto reservoir = std::vector<TrainingRecord>(m_reservoir_size);
+    for (auto& record : reservoir) {
+        if (!next_record(record)) {
+            fail("No training data in the chunks");
+            return;
+        }
+    }
+
+    while (auto batch = claim_batch()) {
+        for (auto i = size_t{0}; i < m_batch_size; i++) {
+            auto pick = rng->randuint32(static_cast<uint32>(reservoir.size()));
+            auto& record = reservoir[pick];
+            decode(record, rng->randfix<Symmetry::NUM_SYMMETRIES>(),
+                   &batch->planes[i * PLANES * PLANE_SIZE],
+                   &batch->probabilities[i * TrainingRecord::PROBABILITIES],
+                   &batch->results[i]);
+            if (!next_record(record)) {
+                fail("No training data in the chunks");
+                return;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            batch->state = SlotState::READY;
+        }
+        m_cv.notify_all();
+    }
+}
+
+void ChunkLoader::next_batch(float* planes, float* probabilities,
+                             float* results) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& batch = m_ring[m_read % RING_SIZE];
+    m_cv.wait(lock, [this, &batch] {
+        return batch.state == SlotState::READY || !m_error.empty();
+    });
+    if (batch.state != SlotState::READY) {
+        throw std::runtime_error(m_error);
+    }
+    // The slot is ours until it is marked free again.
+    lock.unlock();
+    std::copy(begin(batch.planes), end(batch.planes), planes);
+    std::copy(begin(batch.probabilities), end(batch.probabilities),
+              probabilities);
+    std::copy(begin(batch.results), end(batch.results), results);
+    lock.lock();
+    batch.state = SlotState::FREE;
+    m_read++;
+    lock.unlock();
+    m_cv.notify_all();
+}
+
+struct lz_chunkloader {
+    std::unique_ptr<ChunkLoader> loader;
+};
+
+lz_chunkloader* lz_chunkloader_new(const char* const* chunks, int num_chunks,
+                                   int batch_size, int threads,
+                                   int shuffle_size) {
+    if (num_chunks < 1 || batch_size < 1 || threads < 1) {
+        fprintf(stderr, "lz_chunkloader_new: invalid arguments\n");
+        return nullptr;
+    }
+    try {
+        auto names = std::vector<std::string>(chunks, chunks + num_chunks);
+        auto handle = std::make_unique<lz_chunkloader>();
+        handle->loader = std::make_unique<ChunkLoader>(
+            std::move(names), batch_size, threads, std::max(0, shuffle_size));
+        return handle.release();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "lz_chunkloader_new: %s\n", e.what());
+        return nullptr;
+    }
+}
+
+int lz_chunkloader_next_batch(lz_chunkloader* loader, float* planes,
+                              float* probabilities, float* results) {
+    try {
+        loader->loader->next_batch(planes, probabilities, results);
+        return 0;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "lz_chunkloader_next_batch: %s\n", e.what());
+        return -1;
+    }
+}
+
+void lz_chunkloader_free(lz_chunkloader* loader) {
+    delete loader;
+}
@@ -0,0 +1,93 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKLOADER_H_INCLUDED
+#define CHUNKLOADER_H_INCLUDED
+
+#include "config.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TrainingData.h"
+
+/*
+    Streams training chunks (text or binary) on worker threads and
+    turns them into float batches for a trainer, in the layout of
+    training/tf: 18 x 361 input planes, 362 probabilities and the
+    result for each position. Every position gets one of the 8
+    board symmetries at random.
+
+    Each worker cycles through the chunks in its own random order and
+    draws positions from a reservoir of shuffle_size / threads records.
+    Finished batches wait in a ring of RING_SIZE slots.
+*/
+class ChunkLoader {
+public:
+    static constexpr size_t PLANES = TrainingRecord::INPUT_PLANES + 2;
+    static constexpr size_t PLANE_SIZE = 19 * 19;
+    static constexpr size_t RING_SIZE = 8;
+
+    ChunkLoader(std::vector<std::string> chunks, size_t batch_size,
+                int threads, size_t shuffle_size);
+    ~ChunkLoader();
+    ChunkLoader(const ChunkLoader&) = delete;
+    ChunkLoader& operator=(const ChunkLoader&) = delete;
+
+    /*
+        Copies the next batch, blocking until a worker has one ready.
+        planes holds batch_size * PLANES * PLANE_SIZE floats, probabilities
+        batch_size * 362 and results batch_size. Throws if the chunks
+        contain no usable data.
+    */
+    void next_batch(float* planes, float* probabilities, float* results);
+
+    // Decodes a record to floats as seen through the given symmetry.
+    static void decode(const TrainingRecord& record, int symmetry,
+                       float* planes, float* probabilities, float* result);
+
+private:
+    enum class SlotState { FREE, FILLING, READY };
+    struct Batch {
+        SlotState state{SlotState::FREE};
+        std::vector<float> planes;
+        std::vector<float> probabilities;
+        std::vector<float> results;
+    };
+
+    void worker();
+    Batch* claim_batch();
+    void fail(const std::string& error);
+
+    std::vector<std::string> m_chunks;
+    size_t m_batch_size;
+    size_t m_reservoir_size;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Batch> m_ring;
+    size_t m_read{0};
+    size_t m_write{0};
+    bool m_stop{false};
+    std::string m_error;
+    std::vector<std::thread> m_threads;
+};
+
+#endif
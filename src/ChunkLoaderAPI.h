@@ -0,0 +1,52 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKLOADERAPI_H_INCLUDED
+#define CHUNKLOADERAPI_H_INCLUDED
+
+/*
+    C interface to ChunkLoader, exported by libleelaz_data for
+    trainers in other languages (see training/tf/parse.py).
+    Errors are printed to stderr.
+*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lz_chunkloader lz_chunkloader;
+
+/* Returns NULL on invalid arguments. */
+lz_chunkloader* lz_chunkloader_new(const char* const* chunks, int num_chunks,
+                                   int batch_size, int threads,
+                                   int shuffle_size);
+
+/*
+    Fills batch_size * 18 * 361 planes, batch_size * 362 probabilities
+    and batch_size results. Returns 0 on success, -1 if the chunks
+    contain no usable data.
+*/
+int lz_chunkloader_next_batch(lz_chunkloader* loader, float* planes,
+                              float* probabilities, float* results);
+
+void lz_chunkloader_free(lz_chunkloader* loader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
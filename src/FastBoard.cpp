@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include "FastBoard.h"
+#include "Symmetry.h"
 #include "Utils.h"
 #include "Random.h"
 
@@ -105,42 +106,17 @@ void FastBoard::set_square(int x, int y, FastBoard::square_t content) {
     set_square(get_vertex(x, y), content);
 }
 
-int FastBoard::rotate_vertex(int vertex, int symmetry) {
+int FastBoard::rotate_vertex(int vertex, int symmetry) const {
     assert(symmetry >= 0 && symmetry <= 7);
-    std::pair<int, int> xy = get_xy(vertex);
-    int x = xy.first;
-    int y = xy.second;
-    int newx;
-    int newy;
-
-    if (symmetry == 0) {
-        newx = x;
-        newy = y;
-    } else if (symmetry == 1) {
-        newx = m_boardsize - x - 1;
-        newy = y;
-    } else if (symmetry == 2) {
-        newx = x;
-        newy = m_boardsize - y - 1;
-    } else if (symmetry == 3) {
-        newx = m_boardsize - x - 1;
-        newy = m_boardsize - y - 1;
-    } else if (symmetry == 4) {
-        newx = y;
-        newy = x;
-    } else if (symmetry == 5) {
-        newx = m_boardsize - y - 1;
-        newy = x;
-    } else if (symmetry == 6) {
-        newx = y;
-        newy = m_boardsize - x - 1;
-    } else  {
-        assert(symmetry == 7);
-        newx = m_boardsize - y - 1;
-        newy = m_boardsize - x - 1;
+    assert(vertex >= 0 && vertex < m_maxsq);
+
+    if (m_boardsize == MAXBOARDSIZE) {
+        return Symmetry::vertex(symmetry, vertex);
     }
 
-    return get_vertex(newx, newy);
+    // The border rotates along with the board.
+    int size = m_boardsize + 2;
+    return Symmetry::rotate_xy(vertex % size, vertex / size, size, symmetry);
 }
 
 void FastBoard::reset_board(int size) {
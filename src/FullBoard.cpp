@@ -35,6 +35,7 @@ int FullBoard::remove_string(int i) {
     do {
         hash    ^= Zobrist::zobrist[m_square[pos]][pos];
         ko_hash ^= Zobrist::zobrist[m_square[pos]][pos];
+        update_sym_ko_hashes(pos, m_square[pos], EMPTY);
 
         m_square[pos] = EMPTY;
         m_parent[pos] = MAXSQ;
@@ -108,9 +109,7 @@ uint64 FullBoard::calc_hash(void) {
     return res;
 }
 
-std::array<uint64, 8> FullBoard::get_rotated_hashes(void) {
-    std::array<uint64, 8> result;
-
+void FullBoard::calc_sym_ko_hashes(void) {
     for (int sym = 0; sym < 8; sym++) {
         uint64 res = 0x1234567887654321ULL;
 
@@ -120,12 +119,31 @@ std::array<uint64, 8> FullBoard::get_rotated_hashes(void) {
                 res ^= Zobrist::zobrist[m_square[i]][newi];
             }
         }
-        /* prisoner hashing is rule set dependent */
-        res ^= Zobrist::zobrist_pris[0][m_prisoners[0]];
-        res ^= Zobrist::zobrist_pris[1][m_prisoners[1]];
-        if (m_tomove == BLACK)
-           res ^= 0xABCDABCDABCDABCDULL;
-        result[sym] = res;
+        m_sym_ko_hash[sym] = res;
+    }
+
+    assert(m_sym_ko_hash[0] == ko_hash);
+}
+
+void FullBoard::update_sym_ko_hashes(int vertex, square_t from, square_t to) {
+    for (int sym = 0; sym < 8; sym++) {
+        int newi = rotate_vertex(vertex, sym);
+        m_sym_ko_hash[sym] ^= Zobrist::zobrist[from][newi];
+        m_sym_ko_hash[sym] ^= Zobrist::zobrist[to][newi];
+    }
+}
+
+std::array<uint64, 8> FullBoard::get_rotated_hashes(void) {
+    assert(m_sym_ko_hash[0] == ko_hash);
+
+    // The ko hash only covers the stones, the remainder
+    // (prisoners, side to move, passes) is the same in
+    // every symmetry.
+    uint64 nonpositional = hash ^ ko_hash;
+
+    std::array<uint64, 8> result;
+    for (int sym = 0; sym < 8; sym++) {
+        result[sym] = m_sym_ko_hash[sym] ^ nonpositional;
     }
 
     return result;
@@ -149,6 +167,7 @@ int FullBoard::update_board(const int color, const int i, bool &capture) {
 
     hash ^= Zobrist::zobrist[m_square[i]][i];
     ko_hash ^= Zobrist::zobrist[m_square[i]][i];
+    update_sym_ko_hashes(i, EMPTY, (square_t)color);
 
     m_square[i] = (square_t)color;
     m_next[i] = i;
@@ -229,4 +248,5 @@ void FullBoard::reset_board(int size) {
 
     calc_hash();
     calc_ko_hash();
+    calc_sym_ko_hashes();
 }
@@ -45,6 +45,14 @@ public:
 
 private:
     std::array<uint64, 8> get_rotated_hashes(void);
+    void calc_sym_ko_hashes(void);
+    void update_sym_ko_hashes(int vertex, square_t from, square_t to);
+
+    /*
+        ko hash of the board under each symmetry, kept up to date
+        incrementally, the identity (0) is equal to ko_hash
+    */
+    std::array<uint64, 8> m_sym_ko_hash;
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include <sstream>
 #include <cmath>
 #include <climits>
+#include <limits>
 #include <algorithm>
 
 #include "config.h"
@@ -34,21 +35,34 @@
 #include "UCTSearch.h"
 #include "UCTNode.h"
 #include "SGFTree.h"
+#include "SMP.h"
 #include "Network.h"
 #include "TTable.h"
 #include "Training.h"
+#include "SelfPlay.h"
 
 using namespace Utils;
 
 // Configuration flags
 bool cfg_allow_pondering;
 int cfg_num_threads;
+bool cfg_pin_threads;
 int cfg_max_playouts;
+int cfg_max_memory;
 int cfg_lagbuffer_cs;
 int cfg_resignpct;
 int cfg_noise;
 int cfg_random_cnt;
 bool cfg_dumbpass;
+bool cfg_binary_training;
+int cfg_gzip_level;
+int cfg_shuffle_buffer;
+int cfg_selfplay_games;
+int cfg_selfplay_parallel;
+std::string cfg_selfplay_name;
+int cfg_fast_playouts;
+int cfg_full_search_pct;
+bool cfg_benchmark;
 #ifdef USE_OPENCL
 std::vector<int> cfg_gpus;
 int cfg_rowtiles;
@@ -65,7 +79,9 @@ bool cfg_quiet;
 void GTP::setup_default_parameters() {
     cfg_allow_pondering = true;
     cfg_num_threads = std::max(1, std::min(SMP::get_num_cpus(), MAX_CPUS));
+    cfg_pin_threads = false;
     cfg_max_playouts = std::numeric_limits<decltype(cfg_max_playouts)>::max();
+    cfg_max_memory = 2048;
     cfg_lagbuffer_cs = 100;
 #ifdef USE_OPENCL
     cfg_gpus = { };
@@ -79,6 +95,15 @@ void GTP::setup_default_parameters() {
     cfg_noise = false;
     cfg_random_cnt = 0;
     cfg_dumbpass = false;
+    cfg_binary_training = false;
+    cfg_gzip_level = 9;
+    cfg_shuffle_buffer = 1 << 16;
+    cfg_selfplay_games = 0;
+    cfg_selfplay_parallel = 1;
+    cfg_selfplay_name = "selfplay";
+    cfg_fast_playouts = 0;
+    cfg_full_search_pct = 25;
+    cfg_benchmark = false;
     cfg_logfile_handle = nullptr;
     cfg_quiet = false;
 }
@@ -111,9 +136,28 @@ const std::string GTP::s_commands[] = {
     "kgs-time_settings",
     "kgs-game_over",
     "heatmap",
+    "save_tree",
+    "load_tree",
+    "lz-analyze",
+#ifdef USE_LOCK_STATS
+    "lockstats",
+#endif
     ""
 };
 
+/*
+    The search is kept between commands, so that its tree can be saved,
+    or reused when the engine is asked about the same position again.
+*/
+static std::unique_ptr<UCTSearch> s_search;
+
+static UCTSearch & get_search(GameState & game) {
+    if (!s_search) {
+        s_search = std::make_unique<UCTSearch>(game);
+    }
+    return *s_search;
+}
+
 std::string GTP::get_life_list(GameState & game, bool live) {
     std::vector<std::string> stringlist;
     std::string result;
@@ -150,7 +194,9 @@ bool GTP::execute(GameState & game, std::string xinput) {
     bool transform_lowercase = true;
 
     // Required on Unixy systems
-    if (xinput.find("loadsgf") != std::string::npos) {
+    if (xinput.find("loadsgf") != std::string::npos
+        || xinput.find("save_tree") != std::string::npos
+        || xinput.find("load_tree") != std::string::npos) {
         transform_lowercase = false;
     }
 
@@ -325,9 +371,9 @@ bool GTP::execute(GameState & game, std::string xinput) {
             }
             // start thinking
             {
-                auto search = std::make_unique<UCTSearch>(game);
+                auto & search = get_search(game);
 
-                int move = search->think(who);
+                int move = search.think(who);
                 game.play_move(who, move);
 
                 std::string vertex = game.move_to_text(move);
@@ -336,8 +382,8 @@ bool GTP::execute(GameState & game, std::string xinput) {
             if (cfg_allow_pondering) {
                 // now start pondering
                 if (game.get_last_move() != FastBoard::RESIGN) {
-                    auto search = std::make_unique<UCTSearch>(game);
-                    search->ponder();
+                    auto & search = get_search(game);
+                    search.ponder();
                 }
             }
         } else {
@@ -363,9 +409,9 @@ bool GTP::execute(GameState & game, std::string xinput) {
             }
             game.set_passes(0);
             {
-                auto search = std::make_unique<UCTSearch>(game);
+                auto & search = get_search(game);
 
-                int move = search->think(who, UCTSearch::NOPASS);
+                int move = search.think(who, UCTSearch::NOPASS);
                 game.play_move(who, move);
 
                 std::string vertex = game.move_to_text(move);
@@ -374,8 +420,8 @@ bool GTP::execute(GameState & game, std::string xinput) {
             if (cfg_allow_pondering) {
                 // now start pondering
                 if (game.get_last_move() != FastBoard::RESIGN) {
-                    auto search = std::make_unique<UCTSearch>(game);
-                    search->ponder();
+                    auto & search = get_search(game);
+                    search.ponder();
                 }
             }
         } else {
@@ -469,8 +515,8 @@ bool GTP::execute(GameState & game, std::string xinput) {
                 // KGS sends this after our move
                 // now start pondering
                 if (game.get_last_move() != FastBoard::RESIGN) {
-                    auto search = std::make_unique<UCTSearch>(game);
-                    search->ponder();
+                    auto & search = get_search(game);
+                    search.ponder();
                 }
             }
         } else {
@@ -479,9 +525,9 @@ bool GTP::execute(GameState & game, std::string xinput) {
         return true;
     } else if (command.find("auto") == 0) {
         do {
-            auto search = std::make_unique<UCTSearch>(game);
+            auto & search = get_search(game);
 
-            int move = search->think(game.get_to_move(), UCTSearch::NORMAL);
+            int move = search.think(game.get_to_move(), UCTSearch::NORMAL);
             game.play_move(move);
             game.display_state();
 
@@ -490,14 +536,67 @@ bool GTP::execute(GameState & game, std::string xinput) {
 
         return true;
     } else if (command.find("go") == 0) {
-        auto search = std::make_unique<UCTSearch>(game);
+        auto & search = get_search(game);
 
-        int move = search->think(game.get_to_move());
+        int move = search.think(game.get_to_move());
         game.play_move(move);
 
         std::string vertex = game.move_to_text(move);
         myprintf("%s\n", vertex.c_str());
         return true;
+    } else if (command.find("lz-analyze") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp;
+        int interval;
+
+        cmdstream >> tmp;   // eat lz-analyze
+        cmdstream >> interval;
+
+        if (cmdstream.fail()) {
+            // centiseconds
+            interval = 100;
+        } else if (interval <= 0) {
+            gtp_fail_printf(id, "syntax not understood");
+            return true;
+        }
+
+        // The response is open until the next command arrives.
+        if (id != -1) {
+            gtp_line_printf("=%d", id);
+        } else {
+            gtp_line_printf("=");
+        }
+        auto & search = get_search(game);
+        search.ponder(interval);
+        gtp_line_printf("");
+        return true;
+    } else if (command.find("save_tree") == 0
+               || command.find("load_tree") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp, filename;
+
+        cmdstream >> tmp;   // eat save_tree/load_tree
+        cmdstream >> filename;
+
+        if (cmdstream.fail()) {
+            gtp_fail_printf(id, "Missing filename.");
+            return true;
+        }
+
+        auto & search = get_search(game);
+        auto success = false;
+        if (tmp == "save_tree") {
+            success = search.save_tree(filename);
+        } else {
+            success = search.load_tree(filename);
+        }
+
+        if (success) {
+            gtp_printf(id, "");
+        } else {
+            gtp_fail_printf(id, "cannot %s tree", tmp.substr(0, 4).c_str());
+        }
+        return true;
     } else if (command.find("heatmap") == 0) {
         std::istringstream cmdstream(command);
         std::string tmp;
@@ -506,7 +605,11 @@ bool GTP::execute(GameState & game, std::string xinput) {
         cmdstream >> tmp;   // eat heatmap
         cmdstream >> rotation;
 
-        if (!cmdstream.fail()) {
+        if (command.find("average") != std::string::npos) {
+            auto vec = Network::get_scored_moves(
+                &game, Network::Ensemble::AVERAGE);
+            Network::show_heatmap(&game, vec, false);
+        } else if (!cmdstream.fail()) {
             auto vec = Network::get_scored_moves(
                 &game, Network::Ensemble::DIRECT, rotation);
             Network::show_heatmap(&game, vec, false);
@@ -517,6 +620,16 @@ bool GTP::execute(GameState & game, std::string xinput) {
         }
         gtp_printf(id, "");
         return true;
+#ifdef USE_LOCK_STATS
+    } else if (command.find("lockstats") == 0) {
+        if (command.find("reset") != std::string::npos) {
+            SMP::LockSite::reset_stats();
+        } else {
+            SMP::LockSite::dump_stats();
+        }
+        gtp_printf(id, "");
+        return true;
+#endif
     } else if (command.find("fixed_handicap") == 0) {
         std::istringstream cmdstream(command);
         std::string tmp;
@@ -716,6 +829,29 @@ bool GTP::execute(GameState & game, std::string xinput) {
             gtp_fail_printf(id, "syntax not understood");
         }
 
+        return true;
+    } else if (command.find("selfplay") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp, basename;
+        int games;
+
+        // tmp will eat "selfplay", the base name is optional
+        cmdstream >> tmp >> games;
+        if (cmdstream.fail() || games < 1) {
+            gtp_fail_printf(id, "syntax not understood");
+            return true;
+        }
+        if (!(cmdstream >> basename)) {
+            basename = cfg_selfplay_name;
+        }
+        if (cfg_max_playouts == std::numeric_limits<int>::max()) {
+            gtp_fail_printf(id, "self-play needs a playout limit");
+            return true;
+        }
+
+        auto games_per_hour = SelfPlay::play_games(
+            games, cfg_selfplay_parallel, basename);
+        gtp_printf(id, "%d %.1f", games, games_per_hour);
         return true;
     }
 
@@ -25,12 +25,23 @@
 
 extern bool cfg_allow_pondering;
 extern int cfg_num_threads;
+extern bool cfg_pin_threads;
 extern int cfg_max_playouts;
+extern int cfg_max_memory;
 extern int cfg_lagbuffer_cs;
 extern int cfg_resignpct;
 extern int cfg_noise;
 extern int cfg_random_cnt;
 extern bool cfg_dumbpass;
+extern bool cfg_binary_training;
+extern int cfg_gzip_level;
+extern int cfg_shuffle_buffer;
+extern int cfg_selfplay_games;
+extern int cfg_selfplay_parallel;
+extern std::string cfg_selfplay_name;
+extern int cfg_fast_playouts;
+extern int cfg_full_search_pct;
+extern bool cfg_benchmark;
 #ifdef USE_OPENCL
 extern std::vector<int> cfg_gpus;
 extern int cfg_rowtiles;
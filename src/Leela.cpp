@@ -32,6 +32,8 @@
 #include "Random.h"
 #include "Utils.h"
 #include "ThreadPool.h"
+#include "SelfPlay.h"
+#include "Benchmark.h"
 
 using namespace Utils;
 
@@ -54,9 +56,12 @@ void parse_commandline(int argc, char *argv[], bool & gtp_mode) {
         ("threads,t", po::value<int>()->default_value
                       (std::min(2, cfg_num_threads)),
                       "Number of threads to use.")
+        ("pinthreads", "Pin each search thread to its own CPU core.")
         ("playouts,p", po::value<int>(),
                        "Weaken engine by limiting the number of playouts. "
                        "Requires --noponder.")
+        ("maxmemory", po::value<int>()->default_value(cfg_max_memory),
+                      "Maximum memory for the search tree in MiB.")
         ("lagbuffer,b", po::value<int>()->default_value(cfg_lagbuffer_cs),
                         "Safety margin for time usage in centiseconds.")
         ("resignpct,r", po::value<int>()->default_value(cfg_resignpct),
@@ -65,10 +70,30 @@ void parse_commandline(int argc, char *argv[], bool & gtp_mode) {
                         "Play more randomly the first x moves.")
         ("noise,n", "Enable policy network randomization.")
         ("dumbpass,d", "Don't use heuristics for smarter passing.")
+        ("binarytraining", "Write training data in the packed binary format.")
+        ("gziplevel", po::value<int>()->default_value(cfg_gzip_level),
+                      "Compression level of the training data, 0-9.")
+        ("shufflebuffer", po::value<int>()->default_value(cfg_shuffle_buffer),
+                          "Positions dump_supervised shuffles in memory.")
         ("weights,w", po::value<std::string>(), "File with network weights.")
         ("logfile,l", po::value<std::string>(), "File to log input/output to.")
         ("quiet,q", "Disable all diagnostic output.")
         ("noponder", "Disable thinking on opponent's time.")
+        ("selfplay", po::value<int>(),
+                     "Play this many self-play games and exit. "
+                     "Requires --playouts.")
+        ("parallel", po::value<int>()->default_value(cfg_selfplay_parallel),
+                     "Number of self-play games to run at the same time.")
+        ("output,o", po::value<std::string>()->default_value(cfg_selfplay_name),
+                     "Base name of the self-play SGF and training files.")
+        ("fastplayouts", po::value<int>()->default_value(cfg_fast_playouts),
+                         "Self-play: playouts of the moves not used for "
+                         "training, 0 searches every move fully.")
+        ("fullsearchpct", po::value<int>()->default_value(cfg_full_search_pct),
+                          "Self-play: percentage of moves searched with "
+                          "--playouts and used for training.")
+        ("benchmark", "Time the network, board and search on bundled "
+                      "positions, print the results as JSON and exit.")
 #ifdef USE_OPENCL
         ("gpu",  po::value<std::vector<int> >(),
                 "ID of the OpenCL device(s) to use (disables autodetection).")
@@ -166,6 +191,10 @@ void parse_commandline(int argc, char *argv[], bool & gtp_mode) {
         }
     }
 
+    if (vm.count("pinthreads")) {
+        cfg_pin_threads = true;
+    }
+
     if (vm.count("noponder")) {
         cfg_allow_pondering = false;
     }
@@ -178,6 +207,22 @@ void parse_commandline(int argc, char *argv[], bool & gtp_mode) {
         cfg_dumbpass = true;
     }
 
+    if (vm.count("benchmark")) {
+        cfg_benchmark = true;
+    }
+
+    if (vm.count("binarytraining")) {
+        cfg_binary_training = true;
+    }
+
+    if (vm.count("shufflebuffer")) {
+        cfg_shuffle_buffer = std::max(1, vm["shufflebuffer"].as<int>());
+    }
+
+    if (vm.count("gziplevel")) {
+        cfg_gzip_level = std::min(9, std::max(0, vm["gziplevel"].as<int>()));
+    }
+
     if (vm.count("playouts")) {
         cfg_max_playouts = vm["playouts"].as<int>();
         if (!vm.count("noponder")) {
@@ -188,6 +233,40 @@ void parse_commandline(int argc, char *argv[], bool & gtp_mode) {
         }
     }
 
+    if (vm.count("selfplay")) {
+        cfg_selfplay_games = std::max(0, vm["selfplay"].as<int>());
+        if (!vm.count("playouts")) {
+            myprintf("Self-play needs a playout limit, add --playouts.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (vm.count("parallel")) {
+        cfg_selfplay_parallel = std::max(1, vm["parallel"].as<int>());
+    }
+
+    if (vm.count("output")) {
+        cfg_selfplay_name = vm["output"].as<std::string>();
+    }
+
+    if (vm.count("fastplayouts")) {
+        cfg_fast_playouts = std::max(0, vm["fastplayouts"].as<int>());
+    }
+
+    if (vm.count("fullsearchpct")) {
+        auto pct = vm["fullsearchpct"].as<int>();
+        cfg_full_search_pct = std::min(100, std::max(0, pct));
+    }
+
+    if (vm.count("maxmemory")) {
+        int max_memory = vm["maxmemory"].as<int>();
+        max_memory = std::max(1, max_memory);
+        if (max_memory != cfg_max_memory) {
+            myprintf("Using at most %d MiB for the search tree.\n", max_memory);
+            cfg_max_memory = max_memory;
+        }
+    }
+
     if (vm.count("resignpct")) {
         cfg_resignpct = vm["resignpct"].as<int>();
     }
@@ -240,11 +319,12 @@ int main (int argc, char *argv[]) {
     setbuf(stdin, NULL);
 #endif
 
-    if (!gtp_mode) {
+    // The benchmark results are the only thing on stdout.
+    if (!gtp_mode && !cfg_benchmark) {
         license_blurb();
     }
 
-    thread_pool.initialize(cfg_num_threads);
+    thread_pool.initialize(cfg_num_threads, cfg_pin_threads);
 
     // Use deterministic random numbers for hashing
     auto rng = std::make_unique<Random>(5489);
@@ -253,6 +333,18 @@ int main (int argc, char *argv[]) {
     // Initialize network
     Network::initialize();
 
+    if (cfg_benchmark) {
+        auto results = Benchmark::run(cfg_num_threads);
+        printf("%s", results.c_str());
+        return 0;
+    }
+
+    if (cfg_selfplay_games > 0) {
+        SelfPlay::play_games(cfg_selfplay_games, cfg_selfplay_parallel,
+                             cfg_selfplay_name);
+        return 0;
+    }
+
     auto maingame = std::make_unique<GameState>();
 
     /* set board limits */
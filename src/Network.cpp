@@ -50,6 +50,7 @@
 #include "Utils.h"
 #include "FastBoard.h"
 #include "Random.h"
+#include "Symmetry.h"
 #include "Network.h"
 #include "GTP.h"
 #include "Utils.h"
@@ -390,19 +391,25 @@ Network::Netresult Network::get_scored_moves(
 
     if (ensemble == DIRECT) {
         assert(rotation >= 0 && rotation <= 7);
-        result = get_scored_moves_internal(state, planes, rotation);
-    } else {
-        assert(ensemble == RANDOM_ROTATION);
+        result = get_scored_moves_internal(
+            state, get_output_internal(planes, rotation));
+    } else if (ensemble == RANDOM_ROTATION) {
         assert(rotation == -1);
         int rand_rot = Random::get_Rng()->randfix<8>();
-        result = get_scored_moves_internal(state, planes, rand_rot);
+        result = get_scored_moves_internal(
+            state, get_output_internal(planes, rand_rot));
+    } else {
+        assert(ensemble == AVERAGE);
+        assert(rotation == -1);
+        result = get_scored_moves_internal(
+            state, get_output_average(planes));
     }
 
     return result;
 }
 
-Network::Netresult Network::get_scored_moves_internal(
-    GameState * state, NNPlanes & planes, int rotation) {
+Network::Netoutput Network::get_output_internal(
+    NNPlanes & planes, int rotation) {
     assert(rotation >= 0 && rotation <= 7);
     constexpr int channels = INPUT_CHANNELS;
     assert(channels == planes.size());
@@ -420,13 +427,8 @@ Network::Netresult Network::get_scored_moves_internal(
     std::vector<float> winrate_data(256);
     std::vector<float> winrate_out(1);
     for (int c = 0; c < channels; ++c) {
-        for (int h = 0; h < height; ++h) {
-            for (int w = 0; w < width; ++w) {
-                auto rot_idx = rotate_nn_idx(h * 19 + w, rotation);
-                input_data[(c * height + h) * width + w] =
-                    (float)planes[c][rot_idx];
-            }
-        }
+        Symmetry::gather(rotation, planes[c],
+                         &input_data[c * height * width]);
     }
 #ifdef USE_OPENCL
     opencl_net.forward(input_data, output_data);
@@ -453,23 +455,53 @@ Network::Netresult Network::get_scored_moves_internal(
     // Move scores
     std::vector<float>& outputs = softmax_data;
 #endif
+    // Undo the rotation so the policy is in board order
+    std::vector<float> policy((width * height) + 1);
+    Symmetry::scatter(rotation, outputs, policy);
+    policy[width * height] = outputs[width * height];
+
+    return std::make_pair(policy, winrate_sig);
+}
+
+Network::Netoutput Network::get_output_average(NNPlanes & planes) {
+    // Evaluate all 8 symmetries back to back and average the
+    // un-rotated results. The planes are gathered only once.
+    constexpr auto symmetries = 8;
+    auto policy = std::vector<float>((19 * 19) + 1);
+    auto winrate = 0.0f;
+    for (auto sym = 0; sym < symmetries; sym++) {
+        auto output = get_output_internal(planes, sym);
+        for (size_t idx = 0; idx < policy.size(); idx++) {
+            policy[idx] += output.first[idx];
+        }
+        winrate += output.second;
+    }
+    for (auto& val : policy) {
+        val /= symmetries;
+    }
+    winrate /= symmetries;
+
+    return std::make_pair(policy, winrate);
+}
+
+Network::Netresult Network::get_scored_moves_internal(
+    GameState * state, const Netoutput & output) {
+    const auto& policy = output.first;
     std::vector<scored_node> result;
-    for (size_t idx = 0; idx < outputs.size(); idx++) {
+    for (size_t idx = 0; idx < policy.size(); idx++) {
         if (idx < 19*19) {
-            auto val = outputs[idx];
-            auto rot_idx = rotate_nn_idx(idx, rotation);
-            int x = rot_idx % 19;
-            int y = rot_idx / 19;
-            int rot_vtx = state->board.get_vertex(x, y);
-            if (state->board.get_square(rot_vtx) == FastBoard::EMPTY) {
-                result.emplace_back(val, rot_vtx);
+            int x = idx % 19;
+            int y = idx / 19;
+            int vtx = state->board.get_vertex(x, y);
+            if (state->board.get_square(vtx) == FastBoard::EMPTY) {
+                result.emplace_back(policy[idx], vtx);
             }
         } else {
-            result.emplace_back(outputs[idx], FastBoard::PASS);
+            result.emplace_back(policy[idx], FastBoard::PASS);
         }
     }
 
-    return std::make_pair(result, winrate_sig);
+    return std::make_pair(result, output.second);
 }
 
 void Network::show_heatmap(FastState * state, Netresult& result, bool topmoves) {
@@ -571,36 +603,3 @@ void Network::gather_features(GameState * state, NNPlanes & planes) {
         state->forward_move();
     }
 }
-
-int Network::rotate_nn_idx(const int vertex, int symmetry) {
-    assert(vertex >= 0 && vertex < 19*19);
-    assert(symmetry >= 0 && symmetry < 8);
-    int x = vertex % 19;
-    int y = vertex / 19;
-    int newx;
-    int newy;
-
-    if (symmetry >= 4) {
-        std::swap(x, y);
-        symmetry -= 4;
-    }
-
-    if (symmetry == 0) {
-        newx = x;
-        newy = y;
-    } else if (symmetry == 1) {
-        newx = x;
-        newy = 19 - y - 1;
-    } else if (symmetry == 2) {
-        newx = 19 - x - 1;
-        newy = y;
-    } else {
-        assert(symmetry == 3);
-        newx = 19 - x - 1;
-        newy = 19 - y - 1;
-    }
-
-    int newvtx = (newy * 19) + newx;
-    assert(newvtx >= 0 && newvtx < 19*19);
-    return newvtx;
-}
@@ -37,7 +37,7 @@ class UCTNode;
 class Network {
 public:
     enum Ensemble {
-        DIRECT, RANDOM_ROTATION
+        DIRECT, RANDOM_ROTATION, AVERAGE
     };
     using BoardPlane = std::bitset<19*19>;
     using NNPlanes = std::vector<BoardPlane>;
@@ -61,9 +61,14 @@ public:
     static void gather_features(GameState* state, NNPlanes & planes);
 
 private:
+    // Network output mapped back to board order: 361 policy
+    // values plus pass, and the winrate for the side to move.
+    using Netoutput = std::pair<std::vector<float>, float>;
+
+    static Netoutput get_output_internal(NNPlanes & planes, int rotation);
+    static Netoutput get_output_average(NNPlanes & planes);
     static Netresult get_scored_moves_internal(
-      GameState * state, NNPlanes & planes, int rotation);
-    static int rotate_nn_idx(const int vertex, int symmetry);
+      GameState * state, const Netoutput & output);
 };
 
 #endif
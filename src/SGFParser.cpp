@@ -24,24 +24,31 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "Utils.h"
 #include "SGFParser.h"
 
-std::vector<std::string> SGFParser::chop_stream(std::istream& ins,
-                                                size_t stopat) {
-    std::vector<std::string> result;
-    std::string gamebuff;
-
+/*
+    Reads the next complete game from ins into gamebuff. Returns false
+    if the stream ended first, gamebuff then holds what was read.
+*/
+bool SGFParser::read_game(std::istream& ins, std::string& gamebuff,
+                          int& line) {
     ins >> std::noskipws;
 
     int nesting = 0;      // parentheses
     bool intag = false;   // brackets
-    int line = 0;
     gamebuff.clear();
 
     char c;
-    while (ins >> c && result.size() <= stopat) {
+    while (ins >> c) {
         if (c == '\n') line++;
 
         gamebuff.push_back(c);
@@ -66,7 +73,7 @@ std::vector<std::string> SGFParser::chop_stream(std::istream& ins,
             nesting--;
 
             if (nesting == 0) {
-                result.push_back(gamebuff);
+                return true;
             }
         } else if (c == '[' && !intag) {
             intag = true;
@@ -78,6 +85,19 @@ std::vector<std::string> SGFParser::chop_stream(std::istream& ins,
         }
     }
 
+    return false;
+}
+
+std::vector<std::string> SGFParser::chop_stream(std::istream& ins,
+                                                size_t stopat) {
+    std::vector<std::string> result;
+    std::string gamebuff;
+    int line = 0;
+
+    while (result.size() <= stopat && read_game(ins, gamebuff, line)) {
+        result.push_back(gamebuff);
+    }
+
     // No game found? Assume closing tag was missing (OGS)
     if (result.size() == 0) {
         result.push_back(gamebuff);
@@ -88,22 +108,35 @@ std::vector<std::string> SGFParser::chop_stream(std::istream& ins,
 
 std::vector<std::string> SGFParser::chop_all(std::string filename,
                                              size_t stopat) {
-    std::ifstream ins(filename.c_str(), std::ifstream::binary | std::ifstream::in);
+    std::vector<std::string> result;
+    Utils::MappedFile file(filename);
+    SGFScanner scanner(file.data(), file.size());
 
-    if (ins.fail()) {
-        throw std::runtime_error("Error opening file");
+    boost::string_ref game;
+    while (result.size() <= stopat && scanner.next_game(game)) {
+        result.emplace_back(game.to_string());
     }
 
-    auto result = chop_stream(ins, stopat);
-    ins.close();
+    // No game found? Assume closing tag was missing (OGS)
+    if (result.size() == 0) {
+        result.emplace_back(game.to_string());
+    }
 
     return result;
 }
 
 // scan the file and extract the game with number index
 std::string SGFParser::chop_from_file(std::string filename, size_t index) {
-    auto vec = chop_all(filename, index);
-    return vec[index];
+    Utils::MappedFile file(filename);
+    SGFScanner scanner(file.data(), file.size());
+
+    boost::string_ref game;
+    for (auto i = size_t{0}; i <= index; i++) {
+        if (!scanner.next_game(game)) {
+            break;
+        }
+    }
+    return game.to_string();
 }
 
 std::string SGFParser::parse_property_name(std::istringstream & strm) {
@@ -225,46 +258,113 @@ void SGFParser::parse(std::istringstream & strm, SGFTree * node) {
 }
 
 int SGFParser::count_games_in_file(std::string filename) {
-    std::ifstream ins(filename.c_str(), std::ifstream::binary | std::ifstream::in);
+    Utils::MappedFile file(filename);
+    SGFScanner scanner(file.data(), file.size());
 
-    if (ins.fail()) {
-        throw std::runtime_error("Error opening file");
+    int count = 0;
+    boost::string_ref game;
+    while (scanner.next_game(game)) {
+        count++;
     }
 
-    int count = 0;
-    int nesting = 0;
+    return count;
+}
 
-    char c;
-    while (ins >> c) {
-        if (!Utils::is7bit(c)) {
-            do {
-                ins >> c;
-            } while (!Utils::is7bit(c));
-            continue;
+#if defined(__SSE2__) || defined(_M_X64)
+static int lowest_bit(int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/*
+    Position of the next character the scanner cares about:
+    one of ( ) [ ] or backslash. Compares 16 bytes at a time.
+*/
+size_t SGFScanner::find_special(size_t pos) const {
+#if defined(__SSE2__) || defined(_M_X64)
+    const auto open = _mm_set1_epi8('(');
+    const auto close = _mm_set1_epi8(')');
+    const auto tag_open = _mm_set1_epi8('[');
+    const auto tag_close = _mm_set1_epi8(']');
+    const auto escape = _mm_set1_epi8('\\');
+    for (; pos + 16 <= m_size; pos += 16) {
+        auto chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(m_data + pos));
+        auto hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, open),
+                         _mm_cmpeq_epi8(chunk, close)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, tag_open),
+                                      _mm_cmpeq_epi8(chunk, tag_close)),
+                         _mm_cmpeq_epi8(chunk, escape)));
+        auto mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return pos + lowest_bit(mask);
         }
+    }
+#endif
+    for (; pos < m_size; pos++) {
+        switch (m_data[pos]) {
+            case '(': case ')': case '[': case ']': case '\\':
+                return pos;
+        }
+    }
+    return m_size;
+}
+
+bool SGFScanner::next_game(boost::string_ref& game) {
+    int nesting = 0;      // parentheses
+    bool intag = false;   // brackets
+    auto start = m_pos;
+
+    for (;;) {
+        auto pos = find_special(m_pos);
+        if (pos >= m_size) {
+            m_pos = m_size;
+            game = boost::string_ref(m_data + start, m_size - start);
+            return false;
+        }
+        auto c = m_data[pos];
+        m_pos = pos + 1;
 
         if (c == '\\') {
-            // read literal char
-            ins >> c;
-            // Skip special char parsing
+            // Skip the literal char
+            m_pos = std::min(m_pos + 1, m_size);
             continue;
         }
 
-        if (c == '(') {
+        if (c == '(' && !intag) {
+            if (nesting == 0) {
+                // eat ; too
+                while (m_pos < m_size
+                       && std::isspace(static_cast<unsigned char>(m_data[m_pos]))
+                       && m_data[m_pos] != ';') {
+                    m_pos++;
+                }
+                m_pos = std::min(m_pos + 1, m_size);
+                start = m_pos;
+            }
             nesting++;
-        } else if (c == ')') {
+        } else if (c == ')' && !intag) {
             nesting--;
 
-            assert(nesting >= 0);
-
             if (nesting == 0) {
-                // one game processed
-                count++;
+                game = boost::string_ref(m_data + start, m_pos - start);
+                return true;
             }
+        } else if (c == '[' && !intag) {
+            intag = true;
+        } else if (c == ']') {
+            if (intag == false) {
+                auto line = std::count(m_data, m_data + pos, '\n');
+                Utils::myprintf("Tag error on line %d", static_cast<int>(line));
+            }
+            intag = false;
         }
     }
-
-    ins.close();
-
-    return count;
 }
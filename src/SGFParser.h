@@ -22,13 +22,34 @@
 #include <string>
 #include <sstream>
 #include <climits>
+#include <boost/utility/string_ref.hpp>
 
 #include "SGFTree.h"
 
+/*
+    Splits a buffer of concatenated SGF games, such as a memory mapped
+    file, into the same game strings as SGFParser::chop_stream. The
+    games are slices of the buffer, nothing is copied.
+*/
+class SGFScanner {
+public:
+    SGFScanner(const char* data, size_t size)
+        : m_data(data), m_size(size) {};
+    // Returns false once no complete game is left, game then
+    // holds the unfinished rest of the buffer.
+    bool next_game(boost::string_ref& game);
+private:
+    size_t find_special(size_t pos) const;
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos{0};
+};
+
 class SGFParser {
 private:
     static std::string parse_property_name(std::istringstream & strm);
     static bool parse_property_value(std::istringstream & strm, std::string & result);
+    static bool read_game(std::istream& ins, std::string& gamebuff, int& line);
 public:
     static std::string chop_from_file(std::string fname, size_t index);
     static std::vector<std::string> chop_all(std::string fname,
@@ -36,29 +36,28 @@ using namespace Utils;
 
 void SGFTree::init_state(void) {
     m_initialized = true;
+    m_state = std::make_unique<KoState>();
     // Initialize with defaults.
     // The SGF might be missing boardsize or komi
     // which means we'll never initialize properly.
-    m_state.init_game(19, 7.5f);
+    m_state->init_game(19, 7.5f);
 }
 
 KoState * SGFTree::get_state(void) {
     assert(m_initialized);
-    return &m_state;
+    return m_state.get();
 }
 
 SGFTree * SGFTree::get_child(size_t count) {
     if (count < m_children.size()) {
-        assert(m_initialized);
         return &(m_children[count]);
     } else {
         return nullptr;
     }
 }
 
-// This follows the entire line, and doesn't really need the intermediate
-// states, just the moves. As a consequence, states that contain more than
-// just moves won't have any effect.
+// This replays the moves of the line from the root state. Setup properties
+// after the root won't have any effect.
 GameState SGFTree::follow_mainline_state(unsigned int movenum) {
     SGFTree * link = this;
     // This initializes a starting state from a KoState and
@@ -68,7 +67,7 @@ GameState SGFTree::follow_mainline_state(unsigned int movenum) {
     for (unsigned int i = 0; i <= movenum && link != nullptr; i++) {
         // root position has no associated move
         if (i != 0) {
-            int move = link->get_move(result.get_to_move());
+            int move = link->get_move(result.get_to_move(), result.board);
             if (move != SGFTree::EOT) {
                 if (move != FastBoard::PASS && move != FastBoard::EMPTY
                     && result.board.get_square(move) != FastBoard::EMPTY) {
@@ -84,22 +83,6 @@ GameState SGFTree::follow_mainline_state(unsigned int movenum) {
     return result;
 }
 
-KoState * SGFTree::get_state_from_mainline(unsigned int movenum) {
-    SGFTree * link = this;
-    SGFTree * last = this;
-
-    for (unsigned int i = 0; i <= movenum && link != nullptr; i++) {
-        link = link->get_child(0);
-        if (link == nullptr) {
-            return last->get_state();
-        } else {
-            last = link;
-        }
-    }
-
-    return link->get_state();
-}
-
 // the number of states is one more than the number of moves
 int SGFTree::count_mainline_moves(void) {
     SGFTree * link = this;
@@ -122,8 +105,7 @@ void SGFTree::load_from_string(std::string gamebuff) {
     // Set up the root state to defaults
     init_state();
 
-    // populates the states from the moves
-    // split this up in root node, achor (handicap), other nodes
+    // set up the root state from the game properties
     populate_states();
 }
 
@@ -164,7 +146,7 @@ void SGFTree::populate_states(void) {
         strm >> bsize;
         if (bsize <= FastBoard::MAXBOARDSIZE) {
             // Assume 7.5 komi if not specified
-            m_state.init_game(bsize, 7.5f);
+            m_state->init_game(bsize, 7.5f);
             valid_size = true;
         } else {
             throw std::runtime_error("Board size not supported.");
@@ -178,14 +160,14 @@ void SGFTree::populate_states(void) {
         std::istringstream strm(foo);
         float komi;
         strm >> komi;
-        int handicap = m_state.get_handicap();
+        int handicap = m_state->get_handicap();
         // last ditch effort: if no GM or SZ, assume 19x19 Go here
         int bsize = 19;
         if (valid_size) {
-            bsize = m_state.board.get_boardsize();
+            bsize = m_state->board.get_boardsize();
         }
-        m_state.init_game(bsize, komi);
-        m_state.set_handicap(handicap);
+        m_state->init_game(bsize, komi);
+        m_state->set_handicap(handicap);
     }
 
     // handicap
@@ -196,7 +178,7 @@ void SGFTree::populate_states(void) {
         float handicap;
         strm >> handicap;
         has_handicap = (handicap > 0.0f);
-        m_state.set_handicap((int)handicap);
+        m_state->set_handicap((int)handicap);
     }
 
     // result
@@ -234,7 +216,7 @@ void SGFTree::populate_states(void) {
     // Loop through the stone list and apply
     for (auto it = prop_pair_ab.first; it != prop_pair_ab.second; ++it) {
         auto move = it->second;
-        int vtx = string_to_vertex(move);
+        int vtx = string_to_vertex(move, m_state->board);
         apply_move(FastBoard::BLACK, vtx);
     }
 
@@ -242,7 +224,7 @@ void SGFTree::populate_states(void) {
     const auto& prop_pair_aw = m_properties.equal_range("AW");
     for (auto it = prop_pair_aw.first; it != prop_pair_aw.second; ++it) {
         auto move = it->second;
-        int vtx = string_to_vertex(move);
+        int vtx = string_to_vertex(move, m_state->board);
         apply_move(FastBoard::WHITE, vtx);
     }
 
@@ -250,36 +232,16 @@ void SGFTree::populate_states(void) {
     if (it != m_properties.end()) {
         std::string who = it->second;
         if (who == "W") {
-            m_state.set_to_move(FastBoard::WHITE);
+            m_state->set_to_move(FastBoard::WHITE);
         } else if (who == "B") {
-            m_state.set_to_move(FastBoard::BLACK);
+            m_state->set_to_move(FastBoard::BLACK);
         }
     }
-
-    // now for all children play out the moves
-    for (auto& child_state : m_children) {
-        // propagate state
-        child_state.copy_state(*this);
-
-        // XXX: maybe move this to the recursive call
-        // get move for side to move
-        int move = child_state.get_move(m_state.get_to_move());
-        if (move != EOT) {
-            child_state.apply_move(move);
-        }
-
-        child_state.populate_states();
-    }
-}
-
-void SGFTree::copy_state(const SGFTree& tree) {
-    m_initialized = tree.m_initialized;
-    m_state = tree.m_state;
 }
 
 void SGFTree::apply_move(int color, int move) {
     if (move != FastBoard::PASS && move != FastBoard::RESIGN) {
-        int curr_sq = m_state.board.get_square(move);
+        int curr_sq = m_state->board.get_square(move);
         if (curr_sq == !color || curr_sq == FastBoard::INVAL) {
             throw std::runtime_error("Illegal move");
         }
@@ -290,12 +252,7 @@ void SGFTree::apply_move(int color, int move) {
         }
         assert(curr_sq == FastBoard::EMPTY);
     }
-    m_state.play_move(color, move);
-}
-
-void SGFTree::apply_move(int move) {
-    int color = m_state.get_to_move();
-    apply_move(color, move);
+    m_state->play_move(color, move);
 }
 
 void SGFTree::add_property(std::string property, std::string value) {
@@ -311,18 +268,19 @@ SGFTree * SGFTree::add_child() {
     return &(m_children.back());
 }
 
-int SGFTree::string_to_vertex(const std::string& movestring) const {
+int SGFTree::string_to_vertex(const std::string& movestring,
+                              const FastBoard& board) {
     if (movestring.size() == 0) {
         return FastBoard::PASS;
     }
 
-    if (m_state.board.get_boardsize() <= 19) {
+    if (board.get_boardsize() <= 19) {
         if (movestring == "tt") {
             return FastBoard::PASS;
         }
     }
 
-    int bsize = m_state.board.get_boardsize();
+    int bsize = board.get_boardsize();
     if (bsize == 0) {
         throw std::runtime_error("Node has 0 sized board");
     }
@@ -350,12 +308,12 @@ int SGFTree::string_to_vertex(const std::string& movestring) const {
         throw std::runtime_error("Illegal SGF move");
     }
 
-    int vtx = m_state.board.get_vertex(cc1, cc2);
+    int vtx = board.get_vertex(cc1, cc2);
 
     return vtx;
 }
 
-int SGFTree::get_move(int tomove) {
+int SGFTree::get_move(int tomove, const FastBoard& board) const {
     std::string movestring;
 
     if (tomove == FastBoard::BLACK) {
@@ -364,12 +322,10 @@ int SGFTree::get_move(int tomove) {
         movestring = "W";
     }
 
-    PropertyMap::iterator it;
-    it = m_properties.find(movestring);
+    auto it = m_properties.find(movestring);
 
     if (it != m_properties.end()) {
-        std::string movestring = it->second;
-        return string_to_vertex(movestring);
+        return string_to_vertex(it->second, board);
     }
 
     return SGFTree::EOT;
@@ -383,11 +339,12 @@ std::vector<int> SGFTree::get_mainline() {
     std::vector<int> moves;
 
     SGFTree * link = this;
-    int tomove = link->m_state.get_to_move();
+    int tomove = link->m_state->get_to_move();
+    const auto& board = link->m_state->board;
     link = link->get_child(0);
 
-    while (link != nullptr && link->is_initialized()) {
-        int move = link->get_move(tomove);
+    while (link != nullptr) {
+        int move = link->get_move(tomove, board);
         if (move != SGFTree::EOT) {
             moves.push_back(move);
         }
@@ -21,11 +21,17 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
 #include <sstream>
 #include "KoState.h"
 #include "GameState.h"
 
+/*
+    Only the root of the tree holds a board state, with the setup of
+    the game. The other nodes keep just their properties, positions
+    further down are found by replaying the moves on one state.
+*/
 class SGFTree {
 public:
     static const int EOT = 0;               // End-Of-Tree marker
@@ -34,7 +40,6 @@ public:
     void init_state();
 
     KoState * get_state();
-    KoState * get_state_from_mainline(unsigned int movenum = 999);
     GameState follow_mainline_state(unsigned int movenum = 999);
     std::vector<int> get_mainline();
     void load_from_file(std::string filename, int index = 0);
@@ -45,7 +50,7 @@ public:
     void add_property(std::string property, std::string value);
     SGFTree * add_child();
     SGFTree * get_child(size_t count);
-    int get_move(int tomove);
+    int get_move(int tomove, const FastBoard& board) const;
     bool is_initialized() const {
         return m_initialized;
     };
@@ -56,14 +61,13 @@ public:
 private:
     void populate_states(void);
     void apply_move(int color, int move);
-    void apply_move(int move);
-    void copy_state(const SGFTree& state);
-    int string_to_vertex(const std::string& move) const;
+    static int string_to_vertex(const std::string& move,
+                                const FastBoard& board);
 
     using PropertyMap = std::multimap<std::string, std::string>;
 
     bool m_initialized{false};
-    KoState m_state;
+    std::unique_ptr<KoState> m_state;
     FastBoard::square_t m_winner{FastBoard::INVAL};
     std::vector<SGFTree> m_children;
     PropertyMap m_properties;
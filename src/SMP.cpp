@@ -19,7 +19,23 @@
 #include "config.h"
 #include "SMP.h"
 
+#include <algorithm>
 #include <thread>
+#include <vector>
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+#ifdef USE_LOCK_STATS
+#include "Utils.h"
+#endif
+
+// Spin with PAUSE up to this many iterations between polls,
+// after that give up the time slice.
+static constexpr int MAX_BACKOFF = 64;
 
 SMP::Mutex::Mutex() {
     m_lock = false;
@@ -35,7 +51,34 @@ SMP::Lock::Lock(Mutex & m) {
 }
 
 void SMP::Lock::lock() {
-    while (m_mutex->m_lock.exchange(true, std::memory_order_acquire) == true);
+    // Test and test-and-set: only try to grab the cache line
+    // exclusively when the lock looks free.
+    int backoff = 1;
+    int spins = 0;
+    while (m_mutex->m_lock.exchange(true, std::memory_order_acquire)) {
+        while (m_mutex->m_lock.load(std::memory_order_relaxed)) {
+            if (backoff < MAX_BACKOFF) {
+                for (int i = 0; i < backoff; i++) {
+                    CPU_RELAX();
+                }
+                backoff *= 2;
+            } else {
+                std::this_thread::yield();
+            }
+            spins++;
+        }
+    }
+#ifdef USE_LOCK_STATS
+    if (m_site) {
+        m_site->m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (spins) {
+            m_site->m_contended.fetch_add(1, std::memory_order_relaxed);
+            m_site->m_spins.fetch_add(spins, std::memory_order_relaxed);
+        }
+    }
+#else
+    (void)spins;
+#endif
 }
 
 void SMP::Lock::unlock() {
@@ -49,3 +92,46 @@ SMP::Lock::~Lock() {
 int SMP::get_num_cpus() {
     return std::thread::hardware_concurrency();
 }
+
+#ifdef USE_LOCK_STATS
+std::atomic<SMP::LockSite*> SMP::LockSite::s_sites{nullptr};
+
+SMP::Lock::Lock(Mutex & m, LockSite & site) {
+    m_mutex = &m;
+    m_site = &site;
+    lock();
+}
+
+SMP::LockSite::LockSite(const char * file, int line)
+    : m_file(file), m_line(line) {
+    m_next = s_sites.load();
+    while (!s_sites.compare_exchange_weak(m_next, this));
+}
+
+void SMP::LockSite::dump_stats() {
+    std::vector<LockSite*> sites;
+    for (auto site = s_sites.load(); site != nullptr; site = site->m_next) {
+        sites.emplace_back(site);
+    }
+    std::sort(begin(sites), end(sites), [](LockSite* a, LockSite* b) {
+        return a->m_spins > b->m_spins;
+    });
+
+    Utils::myprintf("%12s %12s %14s  site\n", "acquired", "contended", "spins");
+    for (auto site : sites) {
+        Utils::myprintf("%12llu %12llu %14llu  %s:%d\n",
+            (unsigned long long)site->m_acquisitions.load(),
+            (unsigned long long)site->m_contended.load(),
+            (unsigned long long)site->m_spins.load(),
+            site->m_file, site->m_line);
+    }
+}
+
+void SMP::LockSite::reset_stats() {
+    for (auto site = s_sites.load(); site != nullptr; site = site->m_next) {
+        site->m_acquisitions = 0;
+        site->m_contended = 0;
+        site->m_spins = 0;
+    }
+}
+#endif
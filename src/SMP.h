@@ -21,10 +21,33 @@
 
 #include "config.h"
 #include <atomic>
+#include <cstdint>
 
 namespace SMP {
     int get_num_cpus();
 
+#ifdef USE_LOCK_STATS
+    /*
+        Contention counters for one LOCK() call site. Sites register
+        themselves on first use and are never destroyed.
+    */
+    class LockSite {
+    public:
+        LockSite(const char * file, int line);
+        static void dump_stats();
+        static void reset_stats();
+
+        std::atomic<std::uint64_t> m_acquisitions{0};
+        std::atomic<std::uint64_t> m_contended{0};
+        std::atomic<std::uint64_t> m_spins{0};
+    private:
+        const char * m_file;
+        int m_line;
+        LockSite * m_next;
+        static std::atomic<LockSite*> s_sites;
+    };
+#endif
+
     class Mutex {
     public:
         Mutex();
@@ -38,15 +61,27 @@ namespace SMP {
     class Lock {
     public:
         explicit Lock(Mutex & m);
+#ifdef USE_LOCK_STATS
+        Lock(Mutex & m, LockSite & site);
+#endif
         ~Lock();
         void lock();
         void unlock();
     private:
         Mutex * m_mutex;
+#ifdef USE_LOCK_STATS
+        LockSite * m_site{nullptr};
+#endif
     };
 }
 
 // Avoids accidentally creating a temporary
+#ifdef USE_LOCK_STATS
+#define LOCK(mutex, lock) \
+    static SMP::LockSite lock##_site(__FILE__, __LINE__); \
+    SMP::Lock lock((mutex), lock##_site)
+#else
 #define LOCK(mutex, lock) SMP::Lock lock((mutex))
+#endif
 
 #endif
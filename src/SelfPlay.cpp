@@ -0,0 +1,145 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SelfPlay.h"
+#include "FastBoard.h"
+#include "GTP.h"
+#include "Random.h"
+#include "SGFTree.h"
+#include "UCTSearch.h"
+#include "Training.h"
+#include "Utils.h"
+
+using namespace Utils;
+
+float SelfPlay::play_games(int num_games, int parallel,
+                           const std::string & basename) {
+    parallel = std::max(1, std::min(parallel, num_games));
+    // Split the search threads and the tree memory between the games.
+    auto threads = std::max(1, cfg_num_threads / parallel);
+    auto max_memory = std::max(1, cfg_max_memory / parallel);
+
+    myprintf("Playing %d game(s), %d at a time with %d thread(s) each.\n",
+             num_games, parallel, threads);
+
+    // Every game gets a thread of its own to drive the search, the
+    // search workers come from the shared thread pool.
+    Progress progress;
+    auto games = std::vector<std::thread>{};
+    for (auto i = 0; i < parallel; i++) {
+        games.emplace_back(game_loop, std::ref(progress), num_games,
+                           threads, max_memory, std::cref(basename));
+    }
+    for (auto & game : games) {
+        game.join();
+    }
+
+    auto games_per_hour = progress.games_per_hour();
+    myprintf("Played %d game(s), %.1f games/hour.\n",
+             num_games, games_per_hour);
+    return games_per_hour;
+}
+
+float SelfPlay::Progress::games_per_hour() const {
+    // timediff is in centiseconds
+    auto elapsed = std::max(1, Time::timediff(start, Time()));
+    return finished * 60.0f * 60.0f * 100.0f / elapsed;
+}
+
+void SelfPlay::game_loop(Progress & progress, int num_games,
+                         int threads, int max_memory,
+                         const std::string & basename) {
+    for (auto n = progress.next_game++; n < num_games;
+         n = progress.next_game++) {
+        auto game = std::make_unique<GameState>();
+        game->init_game(19, 7.5f);
+        // Training data is kept per thread.
+        Training::clear_training();
+
+        play_game(*game, threads, max_memory);
+
+        auto name = basename + "_" + std::to_string(n);
+        std::ofstream sgf(name + ".sgf");
+        sgf << SGFTree::state_to_string(*game, 0);
+        sgf.close();
+
+        auto winner = get_winner(*game);
+        if (winner != FastBoard::EMPTY) {
+            Training::dump_training(winner, name + ".txt");
+        }
+        progress.finished++;
+        myprintf("Game %d finished after %d moves, %s. %.1f games/hour.\n",
+                 n, static_cast<int>(game->get_movenum()),
+                 winner == FastBoard::BLACK ? "black wins" :
+                 winner == FastBoard::WHITE ? "white wins" : "no result",
+                 progress.games_per_hour());
+    }
+}
+
+void SelfPlay::play_game(GameState & game, int threads, int max_memory) {
+    // No clock, like "time_settings 0 1 0": the playout limit
+    // decides how long each move is searched.
+    game.set_timecontrol(0, 100, 0, 0);
+    auto search = std::make_unique<UCTSearch>(game);
+    search->set_threads(threads);
+    search->set_max_memory(max_memory);
+    // The fast searches are only worth something if the full
+    // searches after them build on their trees.
+    search->set_tree_reuse(cfg_fast_playouts > 0);
+
+    while (game.get_passes() < 2
+           && game.get_last_move() != FastBoard::RESIGN
+           && game.get_movenum() < MAX_MOVES) {
+        // Playout cap randomization: most moves get a quick search
+        // that only moves the game along, the rest get the full
+        // budget and become the training data.
+        auto full_search = cfg_fast_playouts == 0
+            || Random::get_Rng()->randuint32(100)
+               < static_cast<uint32>(cfg_full_search_pct);
+        search->set_playout_limit(full_search ? cfg_max_playouts
+                                              : cfg_fast_playouts);
+        search->set_recording(full_search);
+
+        auto color = game.get_to_move();
+        auto move = search->think(color);
+        game.play_move(color, move);
+    }
+}
+
+int SelfPlay::get_winner(GameState & game) {
+    // After a resignation the side to move is the winner.
+    if (game.get_last_move() == FastBoard::RESIGN) {
+        return game.get_to_move();
+    }
+    auto score = game.final_score();
+    if (score > 0.0f) {
+        return FastBoard::BLACK;
+    } else if (score < 0.0f) {
+        return FastBoard::WHITE;
+    }
+    return FastBoard::EMPTY;
+}
@@ -0,0 +1,61 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SELFPLAY_H_INCLUDED
+#define SELFPLAY_H_INCLUDED
+
+#include <atomic>
+#include <string>
+
+#include "GameState.h"
+#include "Timing.h"
+
+class SelfPlay {
+public:
+    /*
+        Play num_games games against ourselves, parallel of them at
+        the same time, all sharing the loaded network. Game n is
+        written to basename_n.sgf, and its training data to
+        basename_n.txt.0.gz. Noise and random moves follow
+        cfg_noise and cfg_random_cnt like a genmove would. With
+        cfg_fast_playouts set, only cfg_full_search_pct percent of
+        the moves get the full search and are recorded.
+        Returns the number of games played per hour.
+    */
+    static float play_games(int num_games, int parallel,
+                            const std::string & basename);
+
+private:
+    // Longest game we play out, the same limit autogtp uses.
+    static constexpr int MAX_MOVES = 19 * 19 * 2;
+
+    struct Progress {
+        std::atomic<int> next_game{0};
+        std::atomic<int> finished{0};
+        Time start;
+        float games_per_hour() const;
+    };
+
+    static void game_loop(Progress & progress, int num_games,
+                          int threads, int max_memory,
+                          const std::string & basename);
+    static void play_game(GameState & game, int threads, int max_memory);
+    static int get_winner(GameState & game);
+};
+
+#endif
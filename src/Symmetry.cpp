@@ -0,0 +1,29 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include "Symmetry.h"
+
+// Generated at compile time, no initialization order issues.
+constexpr Symmetry::Tables Symmetry::s_tables{};
+
+static_assert(Symmetry::rotate_xy(0, 0, 19, 3) == 19 * 19 - 1,
+              "Symmetry 3 must map the first square to the last.");
+static_assert(Symmetry::rotate_xy(1, 0, 19, 4) == 19,
+              "Symmetry 4 must transpose.");
@@ -0,0 +1,127 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYMMETRY_H_INCLUDED
+#define SYMMETRY_H_INCLUDED
+
+#include "config.h"
+
+#include <cassert>
+
+#include "FastBoard.h"
+
+class Symmetry {
+public:
+    static constexpr int NUM_SYMMETRIES = 8;
+
+    /*
+        squares in the (borderless) network input
+    */
+    static constexpr int NN_SQUARES =
+        FastBoard::MAXBOARDSIZE * FastBoard::MAXBOARDSIZE;
+
+    /*
+        Square (x, y) on a size x size grid that lands on (x, y)
+        under the given symmetry, as a row-major index. Symmetries
+        4-7 transpose first, then 1 and 3 flip vertically and
+        2 and 3 flip horizontally.
+    */
+    static constexpr int rotate_xy(int x, int y, int size, int symmetry) {
+        if (symmetry >= 4) {
+            const int tmp = x;
+            x = y;
+            y = tmp;
+            symmetry -= 4;
+        }
+        if (symmetry == 1 || symmetry == 3) {
+            y = size - y - 1;
+        }
+        if (symmetry == 2 || symmetry == 3) {
+            x = size - x - 1;
+        }
+        return y * size + x;
+    }
+
+    /*
+        Index into the 19x19 network input.
+    */
+    static int nn_idx(int symmetry, int idx) {
+        assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+        assert(idx >= 0 && idx < NN_SQUARES);
+        return s_tables.nn[symmetry][idx];
+    }
+
+    /*
+        Vertex of a full size FastBoard. The border rotates with
+        the board, so every vertex below MAXSQ has an image.
+    */
+    static int vertex(int symmetry, int vertex) {
+        assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+        assert(vertex >= 0 && vertex < FastBoard::MAXSQ);
+        return s_tables.vertex[symmetry][vertex];
+    }
+
+    /*
+        out[i] = in[rotated i], e.g. to build rotated network input
+    */
+    template<typename In, typename Out>
+    static void gather(int symmetry, const In& in, Out&& out) {
+        assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+        const auto& table = s_tables.nn[symmetry];
+        for (int idx = 0; idx < NN_SQUARES; idx++) {
+            out[idx] = in[table[idx]];
+        }
+    }
+
+    /*
+        out[rotated i] = in[i], the inverse of gather
+    */
+    template<typename In, typename Out>
+    static void scatter(int symmetry, const In& in, Out&& out) {
+        assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+        const auto& table = s_tables.nn[symmetry];
+        for (int idx = 0; idx < NN_SQUARES; idx++) {
+            out[table[idx]] = in[idx];
+        }
+    }
+
+    struct Tables {
+        constexpr Tables() : nn(), vertex() {
+            constexpr int nnsize = FastBoard::MAXBOARDSIZE;
+            constexpr int vtxsize = FastBoard::MAXBOARDSIZE + 2;
+            for (int sym = 0; sym < NUM_SYMMETRIES; sym++) {
+                for (int idx = 0; idx < NN_SQUARES; idx++) {
+                    nn[sym][idx] = rotate_xy(idx % nnsize, idx / nnsize,
+                                             nnsize, sym);
+                }
+                for (int vtx = 0; vtx < FastBoard::MAXSQ; vtx++) {
+                    vertex[sym][vtx] = rotate_xy(vtx % vtxsize, vtx / vtxsize,
+                                                 vtxsize, sym);
+                }
+            }
+        }
+
+        unsigned short nn[NUM_SYMMETRIES][NN_SQUARES];
+        unsigned short vertex[NUM_SYMMETRIES][FastBoard::MAXSQ];
+    };
+
+private:
+    static const Tables s_tables;
+};
+
+#endif
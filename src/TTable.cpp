@@ -18,16 +18,12 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "Utils.h"
 #include "TTable.h"
 
-TTable* TTable::get_TT(void) {
-    static TTable s_ttable;
-    return &s_ttable;
-}
-
 TTable::TTable(int size) {
     LOCK(m_mutex, lock);
     m_buckets.resize(size);
@@ -52,6 +48,11 @@ void TTable::update(uint64 hash, const float komi, const UCTNode * node) {
     }
 }
 
+TTable::Stats TTable::get_stats() {
+    LOCK(m_mutex, lock);
+    return m_stats;
+}
+
 void TTable::sync(uint64 hash, const float komi, UCTNode * node) {
     LOCK(m_mutex, lock);
 
@@ -61,9 +62,11 @@ void TTable::sync(uint64 hash, const float komi, UCTNode * node) {
     /*
         check for hash fail
     */
+    m_stats.lookups++;
     if (m_buckets[index].m_hash != hash || m_komi != komi) {
         return;
     }
+    m_stats.hits++;
 
     /*
         valid entry in TT should have more info than tree
@@ -72,7 +75,8 @@ void TTable::sync(uint64 hash, const float komi, UCTNode * node) {
         /*
             entry in TT has more info (new node)
         */
-        node->set_visits(m_buckets[index].m_visits);
-        node->set_blackevals(m_buckets[index].m_eval_sum);
+        auto visits = m_buckets[index].m_visits;
+        node->set_stats(visits, static_cast<float>(
+                                    m_buckets[index].m_eval_sum / visits));
     }
 }
@@ -36,9 +36,10 @@ public:
 class TTable {
 public:
     /*
-        return the global TT
+        Each search owns its table, so that searches with
+        different root noise never share statistics.
     */
-    static TTable* get_TT(void);
+    TTable(int size = 500000);
 
     /*
         update corresponding entry
@@ -50,12 +51,20 @@ public:
     */
     void sync(uint64 hash, const float komi, UCTNode * node);
 
-private:
-    TTable(int size = 500000);
+    /*
+        sync() calls, and how many of them found their position
+    */
+    struct Stats {
+        uint64 lookups{0};
+        uint64 hits{0};
+    };
+    Stats get_stats();
 
+private:
     SMP::Mutex m_mutex;
     std::vector<TTEntry> m_buckets;
-    float m_komi;
+    float m_komi{0.0f};
+    Stats m_stats;
 };
 
 #endif
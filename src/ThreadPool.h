@@ -24,55 +24,293 @@
     distribution.
 */
 
+#include <cassert>
 #include <cstddef>
+#include <atomic>
 #include <vector>
+#include <deque>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <future>
 #include <functional>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Utils {
 
+/*
+    Move-only type erased callable. Callables that fit in the inline
+    buffer are stored without a heap allocation.
+*/
+class Task {
+public:
+    Task() = default;
+    template<class F,
+             class = typename std::enable_if<
+                 !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) {
+        using Fn = typename std::decay<F>::type;
+        emplace<Fn>(std::forward<F>(f), std::integral_constant<bool, fits_inline<Fn>()>());
+    }
+    Task(Task&& other) noexcept {
+        move_from(other);
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return m_ops != nullptr;
+    }
+    void operator()() {
+        m_ops->invoke(&m_storage);
+    }
+
+private:
+    static constexpr std::size_t INLINE_SIZE = 48;
+    using Storage = std::aligned_storage<INLINE_SIZE,
+                                         alignof(std::max_align_t)>::type;
+
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* from, void* to);
+        void (*destroy)(void*);
+    };
+
+    template<class Fn>
+    static constexpr bool fits_inline() {
+        return sizeof(Fn) <= INLINE_SIZE
+            && alignof(Fn) <= alignof(Storage)
+            && std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template<class Fn>
+    struct InlineOps {
+        static void invoke(void* p) {
+            (*static_cast<Fn*>(p))();
+        }
+        static void move(void* from, void* to) {
+            new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        }
+        static void destroy(void* p) {
+            static_cast<Fn*>(p)->~Fn();
+        }
+        static constexpr Ops ops{invoke, move, destroy};
+    };
+
+    template<class Fn>
+    struct HeapOps {
+        static void invoke(void* p) {
+            (**static_cast<Fn**>(p))();
+        }
+        static void move(void* from, void* to) {
+            new (to) Fn*(*static_cast<Fn**>(from));
+        }
+        static void destroy(void* p) {
+            delete *static_cast<Fn**>(p);
+        }
+        static constexpr Ops ops{invoke, move, destroy};
+    };
+
+    template<class Fn, class F>
+    void emplace(F&& f, std::true_type) {
+        new (&m_storage) Fn(std::forward<F>(f));
+        m_ops = &InlineOps<Fn>::ops;
+    }
+    template<class Fn, class F>
+    void emplace(F&& f, std::false_type) {
+        new (&m_storage) Fn*(new Fn(std::forward<F>(f)));
+        m_ops = &HeapOps<Fn>::ops;
+    }
+
+    void move_from(Task& other) {
+        if (other.m_ops) {
+            other.m_ops->move(&other.m_storage, &m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+    void reset() {
+        if (m_ops) {
+            m_ops->destroy(&m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    Storage m_storage;
+    const Ops* m_ops{nullptr};
+};
+
+template<class Fn>
+constexpr Task::Ops Task::InlineOps<Fn>::ops;
+template<class Fn>
+constexpr Task::Ops Task::HeapOps<Fn>::ops;
+
+/*
+    Work stealing pool. Every worker owns a task deque. Tasks submitted
+    from a worker go to its own deque, other submissions are spread
+    round robin. Idle workers steal from the front of the other deques.
+*/
 class ThreadPool {
 public:
     ThreadPool() = default;
     ~ThreadPool();
-    void initialize(std::size_t);
+    void initialize(std::size_t threads, bool pin_threads = false);
+    template<class F>
+    void submit(F&& f);
     template<class F, class... Args>
     auto add_task(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 private:
+    struct Worker {
+        std::mutex m_mutex;
+        std::deque<Task> m_tasks;
+    };
+    struct LocalWorker {
+        ThreadPool* m_pool;
+        std::size_t m_index;
+    };
+    static LocalWorker& local_worker() {
+        static thread_local LocalWorker worker{nullptr, 0};
+        return worker;
+    }
+    static void pin_thread(std::size_t index);
+    std::size_t home_queue();
+    bool pop_task(std::size_t home, Task& task);
+    void worker_loop(std::size_t index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
     std::vector<std::thread> m_threads;
-    std::queue<std::function<void()>> m_tasks;
+
+    // Tasks submitted but not yet taken from a deque.
+    std::atomic<std::size_t> m_pending{0};
+    std::atomic<std::size_t> m_idle{0};
+    std::atomic<std::size_t> m_next{0};
 
     std::mutex m_mutex;
     std::condition_variable m_condvar;
     bool m_exit{false};
 };
 
-inline void ThreadPool::initialize(size_t threads) {
-    for (size_t i = 0; i < threads; i++) {
-        m_threads.emplace_back([this] {
-            for (;;) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(m_mutex);
-                    m_condvar.wait(lock, [this]{ return m_exit || !m_tasks.empty(); });
-                    if (m_exit && m_tasks.empty()) {
-                        return;
-                    }
-                    task = std::move(m_tasks.front());
-                    m_tasks.pop();
-                }
-                task();
+inline void ThreadPool::pin_thread(std::size_t index) {
+#ifdef __linux__
+    auto cpus = std::thread::hardware_concurrency();
+    if (cpus == 0) {
+        return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(index % cpus, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#else
+    (void)index;
+#endif
+}
+
+inline void ThreadPool::initialize(std::size_t threads, bool pin_threads) {
+    for (std::size_t i = 0; i < threads; i++) {
+        m_workers.emplace_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i, pin_threads] {
+            if (pin_threads) {
+                pin_thread(i);
             }
+            worker_loop(i);
         });
     }
 }
 
+inline std::size_t ThreadPool::home_queue() {
+    auto & local = local_worker();
+    if (local.m_pool == this) {
+        return local.m_index;
+    }
+    return m_next++ % m_workers.size();
+}
+
+inline bool ThreadPool::pop_task(std::size_t home, Task& task) {
+    auto num_workers = m_workers.size();
+    // Own work is taken LIFO, it is the most likely to be cache hot.
+    {
+        auto & worker = *m_workers[home];
+        std::lock_guard<std::mutex> lock(worker.m_mutex);
+        if (!worker.m_tasks.empty()) {
+            task = std::move(worker.m_tasks.back());
+            worker.m_tasks.pop_back();
+            m_pending--;
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < num_workers; i++) {
+        auto & victim = *m_workers[(home + i) % num_workers];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if (!victim.m_tasks.empty()) {
+            task = std::move(victim.m_tasks.front());
+            victim.m_tasks.pop_front();
+            m_pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void ThreadPool::worker_loop(std::size_t index) {
+    local_worker() = LocalWorker{this, index};
+    for (;;) {
+        Task task;
+        if (pop_task(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle++;
+        m_condvar.wait(lock, [this]{ return m_exit || m_pending > 0; });
+        m_idle--;
+        if (m_exit && m_pending == 0) {
+            return;
+        }
+    }
+}
+
+template<class F>
+void ThreadPool::submit(F&& f) {
+    assert(!m_workers.empty());
+    Task task(std::forward<F>(f));
+    // Count the task before it becomes visible, so that a worker that
+    // steals it can never see the counter go negative.
+    m_pending++;
+    {
+        auto & worker = *m_workers[home_queue()];
+        std::lock_guard<std::mutex> lock(worker.m_mutex);
+        worker.m_tasks.emplace_back(std::move(task));
+    }
+    if (m_idle > 0) {
+        // Taking the lock orders us against a worker that is between
+        // checking m_pending and going to sleep.
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_condvar.notify_one();
+    }
+}
+
 template<class F, class... Args>
 auto ThreadPool::add_task(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type> {
@@ -83,11 +321,7 @@ auto ThreadPool::add_task(F&& f, Args&&... args)
     );
 
     std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_tasks.emplace([task](){(*task)();});
-    }
-    m_condvar.notify_one();
+    submit([task](){(*task)();});
     return res;
 }
 
@@ -102,25 +336,90 @@ inline ThreadPool::~ThreadPool() {
     }
 }
 
+/*
+    Tracks completion of a set of tasks with a counter instead of a
+    future per task. The first exception thrown by a task is rethrown
+    from wait_all().
+
+    The tasks wait in a queue of the group, and the pool only gets a
+    stub that runs the next one. A waiting thread runs the group's
+    own queued tasks instead of blocking on them, which keeps waits on
+    pool threads from deadlocking, but never picks up unrelated work.
+*/
 class ThreadGroup {
 public:
-    ThreadGroup(ThreadPool & pool) : m_pool(pool) {};
+    ThreadGroup(ThreadPool & pool)
+        : m_pool(pool), m_state(std::make_shared<State>()) {};
+    ~ThreadGroup() {
+        wait_finished();
+    }
     template<class F, class... Args>
     void add_task(F&& f, Args&&... args) {
-        m_taskresults.emplace_back(
-            m_pool.add_task(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+        {
+            std::lock_guard<std::mutex> lock(m_state->m_mutex);
+            m_state->m_tasks.emplace_back(
+                std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+            m_state->m_pending++;
+        }
+        // The stub may run after the group is gone, when the
+        // waiting thread already took its task.
+        m_pool.submit([state = m_state]() { run_next(*state); });
     };
     void wait_all() {
-        for (auto && result: m_taskresults) {
-            result.get();
+        wait_finished();
+        if (m_state->m_exception) {
+            auto exception = m_state->m_exception;
+            m_state->m_exception = nullptr;
+            std::rethrow_exception(exception);
         }
     };
 private:
+    struct State {
+        std::mutex m_mutex;
+        std::condition_variable m_condvar;
+        std::deque<Task> m_tasks;
+        // Queued plus running tasks
+        int m_pending{0};
+        std::exception_ptr m_exception;
+    };
+
+    static bool run_next(State & state) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            if (state.m_tasks.empty()) {
+                return false;
+            }
+            task = std::move(state.m_tasks.front());
+            state.m_tasks.pop_front();
+        }
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            if (!state.m_exception) {
+                state.m_exception = std::current_exception();
+            }
+        }
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        if (--state.m_pending == 0) {
+            state.m_condvar.notify_all();
+        }
+        return true;
+    }
+
+    void wait_finished() {
+        // Help out while our tasks are still queued.
+        while (run_next(*m_state)) {}
+        std::unique_lock<std::mutex> lock(m_state->m_mutex);
+        m_state->m_condvar.wait(lock,
+                                [this]{ return m_state->m_pending == 0; });
+    }
+
     ThreadPool & m_pool;
-    std::vector<std::future<void>> m_taskresults;
+    std::shared_ptr<State> m_state;
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
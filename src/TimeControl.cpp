@@ -192,6 +192,31 @@ int TimeControl::max_time_for_move(int color) {
     return timealloc;
 }
 
+/*
+    Upper bound when the search wants more time than max_time_for_move
+    because the position is unclear.
+*/
+int TimeControl::max_extended_time_for_move(int color) {
+    int timealloc = max_time_for_move(color);
+
+    /*
+        byo yomi periods and stones are allocated exactly,
+        infinite time doesn't need extending
+    */
+    if (m_inbyo[color]
+        || (m_byotime != 0 && m_byostones == 0 && m_byoperiods == 0)) {
+        return timealloc;
+    }
+
+    /*
+        at most double the allocation, and never borrow more
+        than an eighth of the main time that is left
+    */
+    int spare = (m_remaining_time[color] - cfg_lagbuffer_cs) / 8;
+    spare = std::max<int>(spare, 0);
+    return timealloc + std::min<int>(timealloc, spare);
+}
+
 void TimeControl::adjust_time(int color, int time, int stones) {
     m_remaining_time[color] = time;
     // From pachi: some GTP things send 0 0 at the end of main time
@@ -35,6 +35,7 @@ public:
     void start(int color);
     void stop(int color);
     int max_time_for_move(int color);
+    int max_extended_time_for_move(int color);
     void adjust_time(int color, int time, int stones);
     void set_boardsize(int boardsize);
     void display_times();
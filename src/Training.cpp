@@ -24,30 +24,56 @@
 #include <boost/utility.hpp>
 #include "stdlib.h"
 #include "zlib.h"
-#include "string.h"
 
 #include "Training.h"
+#include "GTP.h"
+#include "TrainingData.h"
 #include "UCTNode.h"
 #include "SGFParser.h"
 #include "SGFTree.h"
 #include "Random.h"
+#include "Timing.h"
 #include "Utils.h"
 
-std::vector<TimeStep> Training::m_data{};
+thread_local std::vector<TimeStep> Training::m_data{};
 
 std::string OutputChunker::gen_chunk_name(void) const {
     auto base = std::string{m_basename};
-    base.append("." + std::to_string(m_chunk_count) + ".gz");
+    auto index = m_first_chunk + m_chunk_count * m_chunk_stride;
+    base.append("." + std::to_string(index) + ".gz");
     return base;
 }
 
 OutputChunker::OutputChunker(const std::string& basename,
-                             bool compress)
-    : m_basename(basename), m_compress(compress) {
+                             bool compress, const std::string& header,
+                             size_t first_chunk, size_t chunk_stride)
+    : m_first_chunk(first_chunk), m_chunk_stride(chunk_stride),
+      m_basename(basename), m_header(header), m_compress(compress) {
 }
 
 OutputChunker::~OutputChunker() {
-    flush_chunks();
+    // An empty buffer would give a chunk without positions.
+    try {
+        if (m_step_count > 0) {
+            flush_chunks();
+        }
+    } catch (const std::exception& e) {
+        Utils::myprintf("%s\n", e.what());
+    }
+    // The chunks must be complete once we return.
+    if (m_writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+        }
+        m_condvar.notify_all();
+        m_writer.join();
+    }
+    try {
+        rethrow_write_error();
+    } catch (const std::exception& e) {
+        Utils::myprintf("%s\n", e.what());
+    }
 }
 
 void OutputChunker::append(const std::string& str) {
@@ -58,34 +84,133 @@ void OutputChunker::append(const std::string& str) {
     }
 }
 
-void OutputChunker::flush_chunks() {
-    if (m_compress) {
-        auto chunk_name = gen_chunk_name();
-        auto out = gzopen(chunk_name.c_str(), "wb9");
+void OutputChunker::write_chunk(const std::string& chunk_name,
+                                const std::string& header,
+                                const std::string& data) {
+    auto mode = "wb" + std::to_string(cfg_gzip_level);
+    auto out = gzopen(chunk_name.c_str(), mode.c_str());
+    if (!out) {
+        throw std::runtime_error("Error opening " + chunk_name);
+    }
+    if (!header.empty()) {
+        gzwrite(out, header.data(), header.size());
+    }
+    auto comp_size = gzwrite(out, data.data(), data.size());
+    gzclose(out);
+    if (!comp_size) {
+        throw std::runtime_error("Error in gzip output");
+    }
+}
 
-        auto in_buff_size = m_buffer.size();
-        auto in_buff = std::make_unique<char[]>(in_buff_size);
-        memcpy(in_buff.get(), m_buffer.data(), in_buff_size);
+void OutputChunker::writer_loop() {
+    for (;;) {
+        auto chunk = std::pair<std::string, std::string>{};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condvar.wait(lock, [this] {
+                return m_finished || !m_queue.empty();
+            });
+            // Finish the queue before stopping.
+            if (m_queue.empty()) {
+                return;
+            }
+            chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_condvar.notify_all();
+        try {
+            write_chunk(chunk.first, m_header, chunk.second);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_write_error) {
+                m_write_error = std::current_exception();
+            }
+        }
+    }
+}
 
-        auto comp_size = gzwrite(out, in_buff.get(), in_buff_size);
-        if (!comp_size) {
-            throw std::runtime_error("Error in gzip output");
+void OutputChunker::rethrow_write_error() {
+    auto error = std::exception_ptr{};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(error, m_write_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void OutputChunker::flush_chunks() {
+    if (m_compress) {
+        // Compress on the writer thread, this thread can go on
+        // generating positions. The buffer is moved, not copied.
+        rethrow_write_error();
+        if (!m_writer.joinable()) {
+            m_writer = std::thread(&OutputChunker::writer_loop, this);
         }
         Utils::myprintf("Writing chunk %d\n",  m_chunk_count);
-        gzclose(out);
+        auto size = m_buffer.size();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condvar.wait(lock, [this] {
+                return m_queue.size() < MAX_PENDING_CHUNKS;
+            });
+            m_queue.emplace_back(gen_chunk_name(), std::move(m_buffer));
+        }
+        m_condvar.notify_all();
+        m_buffer = std::string{};
+        m_buffer.reserve(size);
     } else {
         auto chunk_name = m_basename;
         auto flags = std::ofstream::out | std::ofstream::app;
         auto out = std::ofstream{chunk_name, flags};
+        // Chunks are appended to one file, which needs only one header.
+        if (out.tellp() == 0) {
+            out << m_header;
+        }
         out << m_buffer;
         out.close();
+        m_buffer.clear();
     }
 
-    m_buffer.clear();
     m_chunk_count++;
     m_step_count = 0;
 }
 
+ShuffleChunker::ShuffleChunker(const std::string& basename, size_t shards,
+                               size_t reservoir_size,
+                               const std::string& header)
+    : m_reservoir_size(std::max(size_t{1}, reservoir_size)) {
+    for (auto s = size_t{0}; s < shards; s++) {
+        m_shards.emplace_back(std::make_unique<OutputChunker>(
+            basename, true, header, s, shards));
+    }
+    m_reservoir.reserve(m_reservoir_size);
+}
+
+ShuffleChunker::~ShuffleChunker() {
+    std::shuffle(begin(m_reservoir), end(m_reservoir), *Random::get_Rng());
+    for (auto& str : m_reservoir) {
+        output(str);
+    }
+}
+
+void ShuffleChunker::append(std::string&& str) {
+    if (m_reservoir.size() < m_reservoir_size) {
+        m_reservoir.emplace_back(std::move(str));
+        return;
+    }
+    auto slot = Random::get_Rng()->randuint32(
+        static_cast<uint32>(m_reservoir_size));
+    output(m_reservoir[slot]);
+    m_reservoir[slot] = std::move(str);
+}
+
+void ShuffleChunker::output(std::string& str) {
+    m_shards[m_next_shard]->append(str);
+    m_next_shard = (m_next_shard + 1) % m_shards.size();
+}
+
 void Training::clear_training() {
     Training::m_data.clear();
 }
@@ -131,73 +256,120 @@ void Training::record(GameState& state, const UCTNode& root) {
     m_data.emplace_back(step);
 }
 
+std::string Training::chunk_header() {
+    if (cfg_binary_training) {
+        return TrainingRecord::header();
+    }
+    return "";
+}
+
 void Training::dump_training(int winner_color, const std::string& filename) {
-    auto chunker = OutputChunker{filename, true};
+    OutputChunker chunker{filename, true, chunk_header()};
     dump_training(winner_color, chunker);
 }
 
 void Training::dump_training(int winner_color, OutputChunker& outchunk) {
+    auto out = std::string{};
     for (const auto& step : m_data) {
-        auto out = std::stringstream{};
-        // First output 16 times an input feature plane
-        for (auto p = size_t{0}; p < 16; p++) {
-            const auto& plane = step.planes[p];
-            // Write it out as a string of hex characters
-            for (auto bit = size_t{0}; bit + 3 < plane.size(); bit += 4) {
-                auto hexbyte =  plane[bit]     << 3
-                              | plane[bit + 1] << 2
-                              | plane[bit + 2] << 1
-                              | plane[bit + 3] << 0;
-                out << std::hex << hexbyte;
-            }
-            // 361 % 4 = 1 so the last bit goes by itself
-            assert(plane.size() % 4 == 1);
-            out << plane[plane.size() - 1];
-            out << std::dec << std::endl;
-        }
-        // The side to move planes can be compactly encoded into a single
-        // bit, 0 = black to move.
-        out << (step.to_move == FastBoard::BLACK ? "0" : "1") << std::endl;
-        // Then a 362 long array of float probabilities
-        for (auto it = begin(step.probabilities);
-            it != end(step.probabilities); ++it) {
-            out << *it;
-            if (boost::next(it) != end(step.probabilities)) {
-                out << " ";
-            }
+        out.clear();
+        format_step(step, winner_color, out);
+        outchunk.append(out);
+    }
+}
+
+void Training::format_step(const TimeStep& step, int winner_color,
+                           std::string& result) {
+    if (cfg_binary_training) {
+        TrainingRecord(step.planes, step.probabilities,
+                       step.to_move, winner_color).write(result);
+        return;
+    }
+    auto out = std::stringstream{};
+    // First output 16 times an input feature plane
+    for (auto p = size_t{0}; p < 16; p++) {
+        const auto& plane = step.planes[p];
+        // Write it out as a string of hex characters
+        for (auto bit = size_t{0}; bit + 3 < plane.size(); bit += 4) {
+            auto hexbyte =  plane[bit]     << 3
+                          | plane[bit + 1] << 2
+                          | plane[bit + 2] << 1
+                          | plane[bit + 3] << 0;
+            out << std::hex << hexbyte;
         }
-        out << std::endl;
-        // And the game result for the side to move
-        if (step.to_move == winner_color) {
-            out << "1";
-        } else {
-            out << "-1";
+        // 361 % 4 = 1 so the last bit goes by itself
+        assert(plane.size() % 4 == 1);
+        out << plane[plane.size() - 1];
+        out << std::dec << std::endl;
+    }
+    // The side to move planes can be compactly encoded into a single
+    // bit, 0 = black to move.
+    out << (step.to_move == FastBoard::BLACK ? "0" : "1") << std::endl;
+    // Then a 362 long array of float probabilities
+    for (auto it = begin(step.probabilities);
+        it != end(step.probabilities); ++it) {
+        out << *it;
+        if (boost::next(it) != end(step.probabilities)) {
+            out << " ";
         }
-        out << std::endl;
-        outchunk.append(out.str());
     }
+    out << std::endl;
+    // And the game result for the side to move
+    if (step.to_move == winner_color) {
+        out << "1";
+    } else {
+        out << "-1";
+    }
+    out << std::endl;
+    result.append(out.str());
 }
 
-void Training::process_game(GameState& state, size_t& train_pos, int who_won,
-                            const std::vector<int>& tree_moves,
-                            OutputChunker& outchunker) {
-    clear_training();
+size_t Training::process_game(const boost::string_ref& sgf,
+                              std::vector<std::string>& records,
+                              size_t& corrupted) {
+    auto sgftree = std::make_unique<SGFTree>();
+    try {
+        sgftree->load_from_string(sgf.to_string());
+    } catch (...) {
+        return 0;
+    };
+
+    auto tree_moves = sgftree->get_mainline();
+    // Empty game or couldn't be parsed?
+    if (tree_moves.size() == 0) {
+        return 0;
+    }
+
+    auto who_won = sgftree->get_winner();
+    // Accept all komis and handicaps, but reject no usable result
+    if (who_won != FastBoard::BLACK && who_won != FastBoard::WHITE) {
+        return 0;
+    }
+
+    auto state =
+        std::make_unique<GameState>(sgftree->follow_mainline_state());
+    // Our board size is hardcoded in several places
+    if (state->board.get_boardsize() != 19) {
+        return 0;
+    }
+
+    // Records are only kept once the whole game checks out.
+    auto game_records = std::vector<std::string>{};
     auto counter = size_t{0};
-    state.rewind();
+    state->rewind();
 
     do {
-        auto to_move = state.get_to_move();
+        auto to_move = state->get_to_move();
         auto move = tree_moves[counter];
         auto this_move = -1;
 
         // Detect if this SGF seems to be corrupted
-        auto moves = state.generate_moves(to_move);
+        auto moves = state->generate_moves(to_move);
         auto moveseen = false;
         for(const auto& gen_move : moves) {
             if (gen_move == move) {
                 if (move != FastBoard::PASS) {
                     // get x y coords for actual move
-                    auto xy = state.board.get_xy(move);
+                    auto xy = state->board.get_xy(move);
                     this_move = (xy.second * 19) + xy.first;
                 } else {
                     this_move = (19 * 19); // PASS
@@ -208,83 +380,102 @@ void Training::process_game(GameState& state, size_t& train_pos, int who_won,
         }
 
         if (!moveseen) {
-            std::cout << "Mainline move not found: " << move << std::endl;
-            return;
+            corrupted++;
+            return 0;
         }
 
-        // Pick every 1/SKIP_SIZE th position.
-        auto skip = Random::get_Rng()->randfix<SKIP_SIZE>();
-        if (skip == 0) {
-            auto step = TimeStep{};
-            step.to_move = state.board.get_to_move();
-            step.planes = Network::NNPlanes{};
-            Network::gather_features(&state, step.planes);
+        auto step = TimeStep{};
+        step.to_move = state->board.get_to_move();
+        step.planes = Network::NNPlanes{};
+        Network::gather_features(state.get(), step.planes);
 
-            step.probabilities.resize((19 * 19) + 1);
-            step.probabilities[this_move] = 1.0f;
+        step.probabilities.resize((19 * 19) + 1);
+        step.probabilities[this_move] = 1.0f;
 
-            train_pos++;
-            m_data.emplace_back(step);
-        }
+        game_records.emplace_back();
+        format_step(step, who_won, game_records.back());
 
         counter++;
-    } while (state.forward_move() && counter < tree_moves.size());
+    } while (state->forward_move() && counter < tree_moves.size());
 
-    dump_training(who_won, outchunker);
+    for (auto& record : game_records) {
+        records.emplace_back(std::move(record));
+    }
+    return game_records.size();
 }
 
 void Training::dump_supervised(const std::string& sgf_name,
                                const std::string& out_filename) {
-    auto outchunker = OutputChunker{out_filename, true};
-    auto games = SGFParser::chop_all(sgf_name);
-    auto gametotal = games.size();
-    auto train_pos = size_t{0};
+    auto start = Time();
+    Utils::MappedFile file(sgf_name);
+    SGFScanner scanner(file.data(), file.size());
 
-    std::cout << "Total games in file: " << gametotal << std::endl;
-    // Shuffle games around
-    std::cout << "Shuffling...";
-    std::shuffle(begin(games), end(games), *Random::get_Rng());
-    std::cout << "done." << std::endl;
-
-    // Loop over the database multiple times. We will select different
-    // positions from each game on every pass.
-    for (auto repeat = size_t{0}; repeat < SKIP_SIZE; repeat++) {
-        for (auto gamecount = size_t{0}; gamecount < gametotal; gamecount++) {
-            auto sgftree = std::make_unique<SGFTree>();
-            try {
-                sgftree->load_from_string(games[gamecount]);
-            } catch (...) {
-                continue;
-            };
-
-            if (gamecount % (1000) == 0) {
-                std::cout << "Game " << gamecount
-                          << ", " << train_pos << " positions" << std::endl;
-            }
-
-            auto tree_moves = sgftree->get_mainline();
-            // Empty game or couldn't be parsed?
-            if (tree_moves.size() == 0) {
-                continue;
-            }
+    // Mix positions of many games, so that consecutive positions
+    // of one game end up far apart.
+    auto outchunker = std::make_unique<ShuffleChunker>(
+        out_filename, SUPERVISED_SHARDS, cfg_shuffle_buffer, chunk_header());
 
-            auto who_won = sgftree->get_winner();
-            // Accept all komis and handicaps, but reject no usable result
-            if (who_won != FastBoard::BLACK && who_won != FastBoard::WHITE) {
-                continue;
-            }
+    auto games = std::vector<boost::string_ref>{};
+    auto gametotal = size_t{0};
+    auto train_pos = size_t{0};
+    auto corrupted = size_t{0};
+    auto next_report = size_t{0};
+
+    for (;;) {
+        games.clear();
+        auto game = boost::string_ref{};
+        while (games.size() < BATCH_GAMES && scanner.next_game(game)) {
+            games.emplace_back(game);
+        }
+        if (games.empty()) {
+            break;
+        }
+        // Shuffle games around
+        std::shuffle(begin(games), end(games), *Random::get_Rng());
+
+        // Parse and replay the games on the thread pool. The results
+        // are written in task order, so a run only depends on the RNG.
+        auto tasks = (games.size() + TASK_GAMES - 1) / TASK_GAMES;
+        auto results = std::vector<std::vector<std::string>>(tasks);
+        auto positions = std::vector<size_t>(tasks);
+        auto task_corrupted = std::vector<size_t>(tasks);
+        Utils::ThreadGroup tg(thread_pool);
+        for (auto t = size_t{0}; t < tasks; t++) {
+            tg.add_task([&games, &results, &positions, &task_corrupted, t]() {
+                auto last = std::min(games.size(), (t + 1) * TASK_GAMES);
+                for (auto g = t * TASK_GAMES; g < last; g++) {
+                    positions[t] += process_game(games[g], results[t],
+                                                 task_corrupted[t]);
+                }
+            });
+        }
+        tg.wait_all();
 
-            auto state =
-                std::make_unique<GameState>(sgftree->follow_mainline_state());
-            // Our board size is hardcoded in several places
-            if (state->board.get_boardsize() != 19) {
-                continue;
+        for (auto t = size_t{0}; t < tasks; t++) {
+            for (auto& record : results[t]) {
+                outchunker->append(std::move(record));
             }
+            train_pos += positions[t];
+            corrupted += task_corrupted[t];
+        }
 
-            process_game(*state, train_pos, who_won, tree_moves,
-                        outchunker);
+        gametotal += games.size();
+        if (gametotal >= next_report) {
+            std::cout << "Game " << gametotal
+                      << ", " << train_pos << " positions" << std::endl;
+            next_report = gametotal + 10000;
         }
     }
 
+    // Drain the reservoir before timing
+    outchunker.reset();
+
+    std::cout << "Total games in file: " << gametotal << std::endl;
+    std::cout << "Skipped " << corrupted
+              << " games with an illegal mainline move." << std::endl;
     std::cout << "Dumped " << train_pos << " training positions." << std::endl;
+    // Games parsed and replayed per second, output included
+    auto elapsed = std::max(1, Time::timediff(start, Time()));
+    std::cout << "Took " << elapsed / 100.0f << " s, "
+              << gametotal * 100.0f / elapsed << " games/s." << std::endl;
 }
@@ -20,8 +20,17 @@
 #define TRAINING_H_INCLUDED
 
 #include "config.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "GameState.h"
 #include "Network.h"
 
@@ -34,20 +43,68 @@ public:
 
 class OutputChunker {
 public:
-    OutputChunker(const std::string& basename, bool compress = false);
+    // header is written at the start of every chunk. Chunks are
+    // numbered first_chunk, first_chunk + chunk_stride, ...
+    OutputChunker(const std::string& basename, bool compress = false,
+                  const std::string& header = "",
+                  size_t first_chunk = 0, size_t chunk_stride = 1);
     ~OutputChunker();
+    OutputChunker(const OutputChunker&) = delete;
+    OutputChunker& operator=(const OutputChunker&) = delete;
     void append(const std::string& str);
 
     // Group this many positions in a batch.
     static constexpr size_t CHUNK_SIZE = 16384;
+    // Full chunks waiting for the writer thread to compress them,
+    // append() blocks when there are more.
+    static constexpr size_t MAX_PENDING_CHUNKS = 1;
 private:
+    static void write_chunk(const std::string& chunk_name,
+                            const std::string& header,
+                            const std::string& data);
     std::string gen_chunk_name() const;
     void flush_chunks();
+    void writer_loop();
+    void rethrow_write_error();
     size_t m_step_count{0};
     size_t m_chunk_count{0};
+    size_t m_first_chunk{0};
+    size_t m_chunk_stride{1};
     std::string m_buffer;
     std::string m_basename;
+    std::string m_header;
     bool m_compress{false};
+    // Chunk names and buffers queued for m_writer, which is started
+    // with the first compressed chunk. Writes don't take a pool
+    // thread, so they never wait behind search tasks.
+    std::mutex m_mutex;
+    std::condition_variable m_condvar;
+    std::deque<std::pair<std::string, std::string>> m_queue;
+    std::exception_ptr m_write_error;
+    bool m_finished{false};
+    std::thread m_writer;
+};
+
+/*
+    Spreads positions over a number of OutputChunker shards through a
+    shuffle reservoir. Once the reservoir is full, every new position
+    replaces a random one, which goes out to the next shard in turn.
+    The shards compress on their own writer threads in parallel. The chunks of
+    shard s are numbered s, s + shards, ...
+*/
+class ShuffleChunker {
+public:
+    ShuffleChunker(const std::string& basename, size_t shards,
+                   size_t reservoir_size, const std::string& header = "");
+    // Writes out what is left in the reservoir, shuffled.
+    ~ShuffleChunker();
+    void append(std::string&& str);
+private:
+    void output(std::string& str);
+    std::vector<std::unique_ptr<OutputChunker>> m_shards;
+    std::vector<std::string> m_reservoir;
+    size_t m_reservoir_size;
+    size_t m_next_shard{0};
 };
 
 class Training {
@@ -60,16 +117,25 @@ public:
     static void dump_supervised(const std::string& sgf_file,
                                 const std::string& out_filename);
 private:
-    // Consider only every 1/th position in a game.
-    // This ensures that positions in a chunk are from disjoint games.
-    static constexpr size_t SKIP_SIZE = 16;
+    // Output files dump_supervised writes to in parallel.
+    static constexpr size_t SUPERVISED_SHARDS = 16;
+    // Games read from the SGF file at a time, and per pool task.
+    static constexpr size_t BATCH_GAMES = 256;
+    static constexpr size_t TASK_GAMES = 4;
 
-    static void process_game(GameState& state, size_t& train_pos, int who_won,
-                             const std::vector<int>& tree_moves,
-                             OutputChunker& outchunker);
+    // Empty for the text format.
+    static std::string chunk_header();
+    static void format_step(const TimeStep& step, int winner_color,
+                            std::string& out);
+    // Runs on pool threads, counts games with an illegal mainline
+    // move in corrupted instead of printing them.
+    static size_t process_game(const boost::string_ref& sgf,
+                               std::vector<std::string>& records,
+                               size_t& corrupted);
     static void dump_training(int winner_color,
                               OutputChunker& outchunker);
-    static std::vector<TimeStep> m_data;
+    // Per thread, so concurrent self-play games keep separate records.
+    static thread_local std::vector<TimeStep> m_data;
 };
 
 #endif
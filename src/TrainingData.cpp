@@ -0,0 +1,228 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "TrainingData.h"
+#include "FastBoard.h"
+
+static void put_uint16(std::string& out, uint16 val) {
+    out.push_back(static_cast<char>(val & 0xff));
+    out.push_back(static_cast<char>(val >> 8));
+}
+
+static void put_uint32(std::string& out, uint32 val) {
+    put_uint16(out, static_cast<uint16>(val & 0xffff));
+    put_uint16(out, static_cast<uint16>(val >> 16));
+}
+
+static uint16 get_uint16(const unsigned char* data) {
+    return static_cast<uint16>(data[0] | data[1] << 8);
+}
+
+static uint32 get_uint32(const unsigned char* data) {
+    return get_uint16(data) | static_cast<uint32>(get_uint16(data + 2)) << 16;
+}
+
+TrainingRecord::TrainingRecord(const Network::NNPlanes& planes,
+                               const std::vector<float>& probabilities,
+                               int to_move, int winner_color) {
+    assert(planes.size() >= INPUT_PLANES);
+    assert(probabilities.size() == PROBABILITIES);
+    for (auto p = size_t{0}; p < INPUT_PLANES; p++) {
+        auto bytes = &m_planes[p * PLANE_BYTES];
+        for (auto bit = size_t{0}; bit < planes[p].size(); bit++) {
+            if (planes[p][bit]) {
+                bytes[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    }
+    for (auto i = size_t{0}; i < PROBABILITIES; i++) {
+        auto prob = std::min(std::max(probabilities[i], 0.0f), 1.0f);
+        m_probabilities[i] = static_cast<uint16>(std::lround(prob * 65535.0f));
+    }
+    m_to_move = (to_move == FastBoard::BLACK ? 0 : 1);
+    m_result = (to_move == winner_color ? 1 : -1);
+}
+
+std::string TrainingRecord::header() {
+    auto out = std::string{};
+    put_uint32(out, MAGIC);
+    put_uint32(out, VERSION);
+    put_uint32(out, SIZE);
+    return out;
+}
+
+void TrainingRecord::write(std::string& out) const {
+    out.append(reinterpret_cast<const char*>(m_planes.data()),
+               m_planes.size());
+    for (const auto prob : m_probabilities) {
+        put_uint16(out, prob);
+    }
+    out.push_back(static_cast<char>(m_to_move));
+    out.push_back(static_cast<char>(m_result));
+}
+
+void TrainingRecord::read(const unsigned char* data) {
+    std::copy(data, data + m_planes.size(), begin(m_planes));
+    data += m_planes.size();
+    for (auto& prob : m_probabilities) {
+        prob = get_uint16(data);
+        data += sizeof(uint16);
+    }
+    m_to_move = data[0];
+    m_result = static_cast<int8>(data[1]);
+}
+
+bool TrainingRecord::get_bit(size_t plane, size_t vertex) const {
+    auto byte = m_planes[plane * PLANE_BYTES + vertex / 8];
+    return (byte >> (vertex % 8)) & 1;
+}
+
+Network::BoardPlane TrainingRecord::get_plane(size_t plane) const {
+    auto out = Network::BoardPlane{};
+    for (auto vertex = size_t{0}; vertex < out.size(); vertex++) {
+        out[vertex] = get_bit(plane, vertex);
+    }
+    return out;
+}
+
+float TrainingRecord::get_probability(size_t idx) const {
+    return m_probabilities[idx] / 65535.0f;
+}
+
+TrainingReader::TrainingReader(const std::string& filename) {
+    m_file = gzopen(filename.c_str(), "rb");
+    if (!m_file) {
+        throw std::runtime_error("Error opening file");
+    }
+    unsigned char header[TrainingRecord::HEADER_SIZE];
+    auto len = gzread(m_file, header, sizeof(header));
+    if (len != static_cast<int>(sizeof(header))
+        || get_uint32(header) != TrainingRecord::MAGIC) {
+        m_text = true;
+        gzrewind(m_file);
+    } else if (get_uint32(header + 4) != TrainingRecord::VERSION
+               || get_uint32(header + 8) != TrainingRecord::SIZE) {
+        gzclose(m_file);
+        throw std::runtime_error("Unsupported binary training chunk");
+    }
+}
+
+TrainingReader::~TrainingReader() {
+    gzclose(m_file);
+}
+
+bool TrainingReader::read(TrainingRecord& record) {
+    if (m_text) {
+        return read_text(record);
+    }
+    auto len = gzread(m_file, m_buffer.data(), m_buffer.size());
+    if (len != static_cast<int>(m_buffer.size())) {
+        return false;
+    }
+    record.read(m_buffer.data());
+    return true;
+}
+
+bool TrainingReader::read_line(std::string& line) {
+    line.clear();
+    char buffer[4096];
+    while (gzgets(m_file, buffer, sizeof(buffer))) {
+        line.append(buffer);
+        if (line.back() == '\n') {
+            line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    throw std::runtime_error("Malformed training data");
+}
+
+/*
+    The text format of Training::format_step: 16 planes as 90 hex
+    digits plus one bit, side to move, 362 probabilities, result.
+*/
+bool TrainingReader::read_text(TrainingRecord& record) {
+    auto planes = Network::NNPlanes(TrainingRecord::INPUT_PLANES);
+    auto probabilities = std::vector<float>{};
+    auto has_nan = false;
+    do {
+        for (auto& line : m_lines) {
+            if (!read_line(line)) {
+                return false;
+            }
+        }
+        for (auto p = size_t{0}; p < planes.size(); p++) {
+            const auto& line = m_lines[p];
+            if (line.size() != planes[p].size() / 4 + 1) {
+                throw std::runtime_error("Malformed training data");
+            }
+            for (auto bit = size_t{0}; bit + 1 < planes[p].size(); bit += 4) {
+                auto hexbyte = hex_value(line[bit / 4]);
+                planes[p][bit]     = (hexbyte >> 3) & 1;
+                planes[p][bit + 1] = (hexbyte >> 2) & 1;
+                planes[p][bit + 2] = (hexbyte >> 1) & 1;
+                planes[p][bit + 3] = (hexbyte >> 0) & 1;
+            }
+            planes[p][planes[p].size() - 1] = (line.back() == '1');
+        }
+        probabilities.clear();
+        const auto& probs_line = m_lines[TEXT_LINES - 2];
+        auto probs = probs_line.c_str();
+        for (;;) {
+            char* end;
+            auto prob = std::strtof(probs, &end);
+            if (end == probs) {
+                break;
+            }
+            probabilities.push_back(prob);
+            probs = end;
+        }
+        if (probabilities.size() != TrainingRecord::PROBABILITIES) {
+            throw std::runtime_error("Malformed training data");
+        }
+        // Work around a bug in leela-zero v0.3, skip records with NaN.
+        // Look at the text, with -ffast-math std::isnan may be
+        // compiled to false. No valid number contains an n.
+        has_nan = probs_line.find_first_of("nN") != std::string::npos;
+    } while (has_nan);
+
+    auto white_to_move = (m_lines[TEXT_LINES - 3] == "1");
+    auto to_move_won = (m_lines[TEXT_LINES - 1] == "1");
+    auto to_move = white_to_move ? FastBoard::WHITE : FastBoard::BLACK;
+    auto winner = (white_to_move == to_move_won) ? FastBoard::WHITE
+                                                 : FastBoard::BLACK;
+    record = TrainingRecord(planes, probabilities, to_move, winner);
+    return true;
+}
@@ -0,0 +1,100 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRAININGDATA_H_INCLUDED
+#define TRAININGDATA_H_INCLUDED
+
+#include "config.h"
+#include <array>
+#include <string>
+#include <vector>
+#include "zlib.h"
+#include "Network.h"
+
+/*
+    One position of binary training data. A chunk starts with a
+    header (magic, version, record size, all little endian uint32)
+    followed by fixed size records:
+
+    16 input planes, 361 bits each, packed LSB first into 46 bytes
+    362 search probabilities, little endian uint16, scaled to 65535
+    1 byte side to move, 0 = black, 1 = white
+    1 byte game result for the side to move, 1 or -1
+*/
+class TrainingRecord {
+public:
+    static constexpr uint32 MAGIC = 0x44545a4c; // "LZTD"
+    static constexpr uint32 VERSION = 1;
+    static constexpr size_t INPUT_PLANES = 16;
+    static constexpr size_t PLANE_BYTES = (19 * 19 + 7) / 8;
+    static constexpr size_t PROBABILITIES = 19 * 19 + 1;
+    static constexpr size_t HEADER_SIZE = 3 * sizeof(uint32);
+    static constexpr size_t SIZE = INPUT_PLANES * PLANE_BYTES
+                                 + PROBABILITIES * sizeof(uint16) + 2;
+
+    TrainingRecord() = default;
+    TrainingRecord(const Network::NNPlanes& planes,
+                   const std::vector<float>& probabilities,
+                   int to_move, int winner_color);
+
+    static std::string header();
+    // Appends the SIZE bytes of this record.
+    void write(std::string& out) const;
+    void read(const unsigned char* data);
+
+    bool get_bit(size_t plane, size_t vertex) const;
+    Network::BoardPlane get_plane(size_t plane) const;
+    float get_probability(size_t idx) const;
+    int get_to_move() const { return m_to_move; }
+    int get_result() const { return m_result; }
+
+private:
+    std::array<uint8, INPUT_PLANES * PLANE_BYTES> m_planes{};
+    std::array<uint16, PROBABILITIES> m_probabilities{};
+    uint8 m_to_move{0};
+    int8 m_result{0};
+};
+
+/*
+    Reads the records of a chunk, compressed or not. Chunks without
+    the binary header are parsed as text training data. Throws if the
+    file can't be opened or the text is malformed.
+*/
+class TrainingReader {
+public:
+    explicit TrainingReader(const std::string& filename);
+    ~TrainingReader();
+    TrainingReader(const TrainingReader&) = delete;
+    TrainingReader& operator=(const TrainingReader&) = delete;
+    // Returns false at the end of the chunk.
+    bool read(TrainingRecord& record);
+
+private:
+    // 16 planes, side to move, probabilities, result
+    static constexpr size_t TEXT_LINES = TrainingRecord::INPUT_PLANES + 3;
+
+    bool read_text(TrainingRecord& record);
+    bool read_line(std::string& line);
+
+    gzFile m_file;
+    bool m_text{false};
+    std::array<unsigned char, TrainingRecord::SIZE> m_buffer;
+    std::array<std::string, TEXT_LINES> m_lines;
+};
+
+#endif
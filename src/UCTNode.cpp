@@ -23,6 +23,9 @@
 #include <stdio.h>
 #include <assert.h>
 #include <limits>
+#include <array>
+#include <memory>
+#include <new>
 #include <cmath>
 
 #include <iostream>
@@ -44,27 +47,149 @@
 
 using namespace Utils;
 
+static_assert(sizeof(UCTNode) == 24, "UCTNode should stay compact");
+
+/*
+    Storage for all non-root nodes. Nodes are allocated in chunks that
+    are never moved or returned to the system, so an index stays valid
+    (and cheap to turn into a pointer) for the lifetime of the node.
+    Freed nodes are recycled through a free list.
+*/
+class NodePool {
+public:
+    static constexpr auto CHUNK_BITS = 16;
+    static constexpr auto CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    static constexpr auto MAX_CHUNKS = size_t{1} << (32 - CHUNK_BITS);
+
+    // Never destroyed, trees kept in other statics may outlive it.
+    static NodePool& get() {
+        static auto s_pool = new NodePool;
+        return *s_pool;
+    }
+
+    UCTNode* get_node(uint32 index) {
+        assert(index != 0);
+        auto chunk = m_chunks[index >> CHUNK_BITS].get();
+        return reinterpret_cast<UCTNode*>(&chunk[index & (CHUNK_SIZE - 1)]);
+    }
+
+    // Reserve count uninitialized slots.
+    void allocate(size_t count, std::vector<uint32> & indices) {
+        LOCK(m_mutex, lock);
+        while (count > 0 && !m_free.empty()) {
+            indices.emplace_back(m_free.back());
+            m_free.pop_back();
+            count--;
+        }
+        while (count > 0) {
+            auto chunk = m_next >> CHUNK_BITS;
+            if (chunk >= MAX_CHUNKS) {
+                throw std::bad_alloc();
+            }
+            if (!m_chunks[chunk]) {
+                m_chunks[chunk] = std::make_unique<Slot[]>(CHUNK_SIZE);
+            }
+            indices.emplace_back(static_cast<uint32>(m_next++));
+            count--;
+        }
+    }
+
+    void release(const std::vector<uint32> & indices) {
+        LOCK(m_mutex, lock);
+        m_free.insert(end(m_free), begin(indices), end(indices));
+    }
+
+private:
+    using Slot = std::aligned_storage<sizeof(UCTNode),
+                                      alignof(UCTNode)>::type;
+
+    // Index 0 means no node, never hand it out.
+    size_t m_next{1};
+    std::vector<uint32> m_free;
+    std::array<std::unique_ptr<Slot[]>, MAX_CHUNKS> m_chunks;
+    SMP::Mutex m_mutex;
+};
+
+static uint64 pack_stats(int visits, float blackeval) {
+    uint32 bits;
+    memcpy(&bits, &blackeval, sizeof(bits));
+    return (uint64{static_cast<uint32>(visits)} << 32) | bits;
+}
+
+static int unpack_visits(uint64 stats) {
+    return static_cast<int>(stats >> 32);
+}
+
+static float unpack_blackeval(uint64 stats) {
+    auto bits = static_cast<uint32>(stats);
+    float blackeval;
+    memcpy(&blackeval, &bits, sizeof(blackeval));
+    return blackeval;
+}
+
+static uint16 score_to_fixed(float score) {
+    score = std::min(1.0f, std::max(0.0f, score));
+    return static_cast<uint16>(std::lround(score * 65535.0f));
+}
+
 UCTNode::UCTNode(int vertex, float score)
-    : m_move(vertex), m_score(score) {
+    : m_move(static_cast<int16>(vertex)), m_score(score_to_fixed(score)) {
 }
 
 UCTNode::~UCTNode() {
-    LOCK(get_mutex(), lock);
-    UCTNode * next = m_firstchild;
+    release_nodes(m_firstchild);
+}
 
-    while (next != nullptr) {
-        UCTNode * tmp = next->m_nextsibling;
-        delete next;
-        next = tmp;
+/*
+    Free the node list starting at first, and everything below it.
+    Nodes own nothing but their children, so they go back to the pool
+    without running their destructors, in batches to keep the pool
+    lock short. Returns the number of nodes freed.
+*/
+int UCTNode::release_nodes(uint32 first) {
+    constexpr auto BATCH_SIZE = size_t{4096};
+    auto freed = 0;
+    auto pending = std::vector<uint32>{};
+    auto batch = std::vector<uint32>{};
+
+    if (first != 0) {
+        pending.emplace_back(first);
+    }
+    while (!pending.empty()) {
+        auto index = pending.back();
+        pending.pop_back();
+        auto node = get_node(index);
+        if (node->m_firstchild != 0) {
+            pending.emplace_back(node->m_firstchild);
+        }
+        if (node->m_nextsibling != 0) {
+            pending.emplace_back(node->m_nextsibling);
+        }
+        batch.emplace_back(index);
+        freed++;
+        if (batch.size() == BATCH_SIZE) {
+            NodePool::get().release(batch);
+            batch.clear();
+        }
+    }
+    NodePool::get().release(batch);
+
+    return freed;
+}
+
+UCTNode* UCTNode::get_node(uint32 index) {
+    if (index == 0) {
+        return nullptr;
     }
+    return NodePool::get().get_node(index);
 }
 
 bool UCTNode::first_visit() const {
-    return m_visits == 0;
+    return get_visits() == 0;
 }
 
-void UCTNode::link_child(UCTNode * newchild) {
-    newchild->m_nextsibling = m_firstchild;
+void UCTNode::link_child(uint32 newchild) {
+    get_node(newchild)->m_nextsibling = m_firstchild;
     m_firstchild = newchild;
 }
 
@@ -74,7 +199,8 @@ SMP::Mutex & UCTNode::get_mutex() {
 
 bool UCTNode::create_children(std::atomic<int> & nodecount,
                               GameState & state,
-                              float & eval) {
+                              float & eval,
+                              Network::Ensemble ensemble) {
     // check whether somebody beat us to it (atomic)
     if (has_children()) {
         return false;
@@ -90,15 +216,14 @@ bool UCTNode::create_children(std::atomic<int> & nodecount,
         return false;
     }
     // Someone else is running the expansion
-    if (m_is_expanding) {
+    if (m_flags & EXPANDING) {
         return false;
     }
     // We'll be the one queueing this node for expansion, stop others
-    m_is_expanding = true;
+    m_flags |= EXPANDING;
     lock.unlock();
 
-    auto raw_netlist = Network::get_scored_moves(
-        &state, Network::Ensemble::RANDOM_ROTATION);
+    auto raw_netlist = Network::get_scored_moves(&state, ensemble);
 
     // DCNN returns winrate as side to move
     auto net_eval = raw_netlist.second;
@@ -143,23 +268,309 @@ void UCTNode::link_nodelist(std::atomic<int> & nodecount,
     int childrenadded = 0;
     size_t childrenseen = 0;
 
+    auto indices = std::vector<uint32>{};
+    indices.reserve(std::min(totalchildren, maxchilds));
+    NodePool::get().allocate(std::min(totalchildren, maxchilds), indices);
+
     LOCK(get_mutex(), lock);
 
     for (const auto& node : nodelist) {
         if (totalchildren - childrenseen <= maxchilds) {
-            auto vtx = new UCTNode(node.second, node.first);
-            link_child(vtx);
+            auto index = indices[childrenadded];
+            new (get_node(index)) UCTNode(node.second, node.first);
+            link_child(index);
             childrenadded++;
         }
         childrenseen++;
     }
 
     nodecount += childrenadded;
-    m_has_children = true;
+    m_flags |= HAS_CHILDREN;
 }
 
-void UCTNode::kill_superkos(KoState & state) {
-    UCTNode * child = m_firstchild;
+/*
+    Free the children of every descendant with fewer than min_visits
+    visits. The nodes keep their statistics and are expanded again
+    when the search comes back. Not thread safe, the search must be
+    stopped. Returns the number of nodes freed.
+*/
+int UCTNode::prune_subtrees(int min_visits) {
+    auto pruned = 0;
+    auto child = get_first_child();
+
+    while (child != nullptr) {
+        if (child->get_visits() < min_visits) {
+            pruned += child->unexpand();
+        } else {
+            pruned += child->prune_subtrees(min_visits);
+        }
+        child = child->get_sibling();
+    }
+
+    return pruned;
+}
+
+int UCTNode::unexpand() {
+    auto freed = release_nodes(m_firstchild);
+
+    m_firstchild = 0;
+    m_flags &= ~(HAS_CHILDREN | EXPANDING);
+
+    return freed;
+}
+
+/*
+    Detach all children and free them on the thread pool, so the
+    caller doesn't wait for a big tree to be taken apart.
+    Not thread safe, the search must be stopped.
+*/
+void UCTNode::release_children() {
+    auto first = m_firstchild;
+
+    m_firstchild = 0;
+    m_flags &= ~(HAS_CHILDREN | EXPANDING);
+
+    if (first != 0) {
+        thread_pool.submit([first]() {
+            release_nodes(first);
+        });
+    }
+}
+
+/*
+    Make the subtree below the child that plays move the whole tree,
+    stats included. The other children are freed on the thread pool.
+    Not thread safe, the search must be stopped.
+*/
+bool UCTNode::promote_child(int move) {
+    UCTNode * found = nullptr;
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (child->valid() && child->get_move() == move) {
+            found = child;
+            break;
+        }
+    }
+    if (found == nullptr) {
+        return false;
+    }
+
+    auto grandchildren = found->m_firstchild;
+    auto expanded = found->has_children();
+    auto stats = found->m_stats.load();
+    found->m_firstchild = 0;
+    release_children();
+
+    m_firstchild = grandchildren;
+    if (expanded) {
+        m_flags |= HAS_CHILDREN;
+    }
+    m_stats = stats;
+    return true;
+}
+
+int UCTNode::count_nodes() const {
+    auto count = 0;
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        count += 1 + child->count_nodes();
+    }
+    return count;
+}
+
+template<typename T>
+static void write_raw(std::ostream & out, const T & value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static bool read_raw(std::istream & in, T & value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value),
+                                     sizeof(T)));
+}
+
+/*
+    Binary tree format, in host byte order. Every node is stored as
+    move (int16), prior (uint16, fixed point), visits (int32) and mean
+    black eval (float). A node is followed by its children block: the
+    number of children (uint16), their stats, then the children block
+    of each child in turn. Invalid children are left out.
+    The tree is written and read depth first straight from/to the
+    stream, so it is never held in memory twice.
+    Loading replays the moves on state, the position of the root, and
+    rejects anything the search could not have produced.
+    Not thread safe, the search must be stopped.
+*/
+void UCTNode::save_tree(std::ostream & out) const {
+    write_stats(out);
+    save_children(out);
+}
+
+bool UCTNode::load_tree(std::istream & in, KoState & state,
+                        std::atomic<int> & nodecount, int maxnodes) {
+    assert(!has_children());
+    auto count = uint16{0};
+    return read_stats(in) && read_raw(in, count)
+        && load_children(in, count, state, nodecount, maxnodes);
+}
+
+void UCTNode::write_stats(std::ostream & out) const {
+    // The transposition table can give a child more visits than its
+    // parent. Store a tree that adds up, loading checks it.
+    const auto stats = m_stats.load();
+    auto visits = int64{unpack_visits(stats)};
+    auto child_visits = int64{0};
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (child->valid()) {
+            child_visits += child->get_visits();
+        }
+    }
+    visits = std::min<int64>(std::max(visits, child_visits),
+                             std::numeric_limits<int32>::max());
+    write_raw(out, m_move);
+    write_raw(out, m_score);
+    write_raw(out, static_cast<int32>(visits));
+    write_raw(out, unpack_blackeval(stats));
+}
+
+bool UCTNode::read_stats(std::istream & in) {
+    int16 move;
+    uint16 score;
+    int32 visits;
+    float blackeval;
+    if (!read_raw(in, move) || !read_raw(in, score)
+        || !read_raw(in, visits) || !read_raw(in, blackeval)) {
+        return false;
+    }
+    // Also false for NaN
+    if (visits < 0 || !(blackeval >= 0.0f && blackeval <= 1.0f)) {
+        return false;
+    }
+    m_move = move;
+    m_score = score;
+    set_stats(visits, blackeval);
+    return true;
+}
+
+void UCTNode::save_children(std::ostream & out) const {
+    auto count = uint16{0};
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (child->valid()) {
+            count++;
+        }
+    }
+    write_raw(out, count);
+
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (child->valid()) {
+            child->write_stats(out);
+        }
+    }
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (child->valid()) {
+            child->save_children(out);
+        }
+    }
+}
+
+/*
+    Moves a node can have in state: pass, or an empty vertex that is
+    neither the ko square nor suicide.
+*/
+static bool is_legal_child(KoState & state, int move) {
+    if (move == FastBoard::PASS) {
+        return true;
+    }
+    if (move < 0 || move >= FastBoard::MAXSQ) {
+        return false;
+    }
+    return state.board.get_square(move) == FastBoard::EMPTY
+        && move != state.get_komove()
+        && !state.board.is_suicide(move, state.get_to_move());
+}
+
+/*
+    On failure the children read so far stay linked, the caller
+    has to unexpand() the root.
+    count is the number of children, already read.
+*/
+bool UCTNode::load_children(std::istream & in, uint16 count, KoState & state,
+                            std::atomic<int> & nodecount, int maxnodes) {
+    if (count == 0) {
+        return true;
+    }
+    if (nodecount + count > maxnodes) {
+        return false;
+    }
+
+    auto indices = std::vector<uint32>{};
+    indices.reserve(count);
+    NodePool::get().allocate(count, indices);
+
+    // Linking prepends, go backwards to keep the saved order.
+    for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+        new (get_node(*it)) UCTNode(FastBoard::PASS, 0.0f);
+        link_child(*it);
+    }
+    nodecount += count;
+    m_flags |= HAS_CHILDREN;
+
+    // Pass is stored at the end.
+    auto seen = std::vector<bool>(FastBoard::MAXSQ + 1);
+    auto child_visits = int64{0};
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (!child->read_stats(in)) {
+            return false;
+        }
+        auto move = child->get_move();
+        if (!is_legal_child(state, move)) {
+            return false;
+        }
+        auto idx = (move == FastBoard::PASS ? FastBoard::MAXSQ : move);
+        if (seen[idx]) {
+            return false;
+        }
+        seen[idx] = true;
+        child_visits += child->get_visits();
+    }
+    if (child_visits > get_visits()) {
+        return false;
+    }
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        auto grandchildren = uint16{0};
+        if (!read_raw(in, grandchildren)) {
+            return false;
+        }
+        // Most nodes are leaves, only copy the position when needed.
+        if (grandchildren == 0) {
+            continue;
+        }
+        auto childstate = state;
+        if (child->get_move() != FastBoard::PASS) {
+            childstate.play_move(child->get_move());
+        } else {
+            childstate.play_pass();
+        }
+        if (!child->load_children(in, grandchildren, childstate,
+                                  nodecount, maxnodes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Returns the number of nodes freed.
+*/
+int UCTNode::kill_superkos(KoState & state) {
+    auto freed = 0;
+    UCTNode * child = get_first_child();
 
     while (child != nullptr) {
         int move = child->get_move();
@@ -169,23 +580,25 @@ void UCTNode::kill_superkos(KoState & state) {
             mystate.play_move(move);
 
             if (mystate.superko()) {
-                UCTNode * tmp = child->m_nextsibling;
-                delete_child(child);
+                UCTNode * tmp = child->get_sibling();
+                freed += delete_child(child);
                 child = tmp;
                 continue;
             }
         }
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
+
+    return freed;
 }
 
 void UCTNode::dirichlet_noise(float epsilon, float alpha) {
-    auto child = m_firstchild;
+    auto child = get_first_child();
     auto child_cnt = size_t{0};
 
     while (child != nullptr) {
         child_cnt++;
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 
     auto dirichlet_vector = std::vector<float>{};
@@ -208,26 +621,26 @@ void UCTNode::dirichlet_noise(float epsilon, float alpha) {
         v /= sample_sum;
     }
 
-    child = m_firstchild;
+    child = get_first_child();
     child_cnt = 0;
     while (child != nullptr) {
         auto score = child->get_score();
         auto eta_a = dirichlet_vector[child_cnt];
         score = score * (1 - epsilon) + epsilon * eta_a;
         child->set_score(score);
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 }
 
 void UCTNode::randomize_first_proportionally() {
     auto accum_vector = std::vector<uint32>{};
 
-    auto child = m_firstchild;
+    auto child = get_first_child();
     auto accum = uint32{0};
     while (child != nullptr) {
         accum += child->get_visits();
         accum_vector.emplace_back(accum);
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 
     auto pick = Random::get_Rng()->randuint32(accum);
@@ -245,7 +658,7 @@ void UCTNode::randomize_first_proportionally() {
     }
 
     // Now swap the child at index with the first child
-    child = m_firstchild;
+    child = get_first_child();
     auto child_cnt = size_t{0};
     while (child != nullptr) {
         // Because of the early out we can't be swapping the first
@@ -253,18 +666,18 @@ void UCTNode::randomize_first_proportionally() {
         // pointer.
         if (index == child_cnt + 1) {
             // We stopped one early, so we should have a successor
-            assert(child->m_nextsibling != nullptr);
+            assert(child->m_nextsibling != 0);
             auto old_first = m_firstchild;
-            auto old_next = child->m_nextsibling->m_nextsibling;
+            auto old_next = get_node(child->m_nextsibling)->m_nextsibling;
             // Set up links for the new first node
             m_firstchild = child->m_nextsibling;
-            m_firstchild->m_nextsibling = old_first;
+            get_node(m_firstchild)->m_nextsibling = old_first;
             // Point through our nextsibling ptr
             child->m_nextsibling = old_next;
             return;
         }
         child_cnt++;
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 }
 
@@ -281,37 +694,43 @@ void UCTNode::virtual_loss_undo() {
 }
 
 void UCTNode::update(float eval) {
-    m_visits++;
     accumulate_eval(eval);
 }
 
 bool UCTNode::has_children() const {
-    return m_has_children;
+    return m_flags & HAS_CHILDREN;
 }
 
-void UCTNode::set_visits(int visits) {
-    m_visits = visits;
+void UCTNode::set_stats(int visits, float blackeval) {
+    m_stats = pack_stats(visits, blackeval);
 }
 
 float UCTNode::get_score() const {
-    return m_score;
+    return m_score / 65535.0f;
 }
 
 void UCTNode::set_score(float score) {
-    m_score = score;
+    m_score = score_to_fixed(score);
 }
 
 int UCTNode::get_visits() const {
-    return m_visits;
+    return unpack_visits(m_stats);
 }
 
 float UCTNode::get_eval(int tomove) const {
     // Due to the use of atomic updates and virtual losses, it is
     // possible for the visit count to change underneath us. Make sure
     // to return a consistent result to the caller by caching the values.
-    auto visits = get_visits() + m_virtual_loss;
-    auto blackeval = get_blackevals();
+    const int virtual_loss = m_virtual_loss;
+    const auto stats = m_stats.load();
+    auto visits = unpack_visits(stats) + virtual_loss;
+    auto blackeval = (double)unpack_blackeval(stats) * unpack_visits(stats);
     if (visits > 0) {
+        // Virtual losses are losses for the side to move, so for
+        // white they count as black wins.
+        if (tomove == FastBoard::WHITE) {
+            blackeval += virtual_loss;
+        }
         auto score = static_cast<float>(blackeval / (double)visits);
         if (tomove == FastBoard::WHITE) {
             score = 1.0f - score;
@@ -325,15 +744,19 @@ float UCTNode::get_eval(int tomove) const {
 }
 
 double UCTNode::get_blackevals() const {
-    return m_blackevals;
-}
-
-void UCTNode::set_blackevals(double blackevals) {
-    m_blackevals = blackevals;
+    const auto stats = m_stats.load();
+    return (double)unpack_blackeval(stats) * unpack_visits(stats);
 }
 
+// Count a visit and fold its eval into the mean, both at once.
 void UCTNode::accumulate_eval(float eval) {
-    atomic_add(m_blackevals, (double)eval);
+    auto old = m_stats.load();
+    auto stats = uint64{};
+    do {
+        auto visits = unpack_visits(old) + 1;
+        auto mean = unpack_blackeval(old);
+        stats = pack_stats(visits, mean + (eval - mean) / visits);
+    } while (!m_stats.compare_exchange_weak(old, stats));
 }
 
 UCTNode* UCTNode::uct_select_child(int color) {
@@ -345,31 +768,31 @@ UCTNode* UCTNode::uct_select_child(int color) {
     // int childbound = std::max(2, (int)(((log((double)get_visits()) - 3.0) * 3.0) + 2.0));
     int childbound = 362;
     int childcount = 0;
-    UCTNode * child = m_firstchild;
+    UCTNode * child = get_first_child();
 
     // Count parentvisits.
     // We do this manually to avoid issues with transpositions.
     int parentvisits = 0;
     // Make sure we are at a valid successor.
     while (child != nullptr && !child->valid()) {
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
     while (child != nullptr  && childcount < childbound) {
         parentvisits      += child->get_visits();
-        child = child->m_nextsibling;
+        child = child->get_sibling();
         // Make sure we are at a valid successor.
         while (child != nullptr && !child->valid()) {
-            child = child->m_nextsibling;
+            child = child->get_sibling();
         }
         childcount++;
     }
     float numerator = std::sqrt((double)parentvisits);
 
     childcount = 0;
-    child = m_firstchild;
+    child = get_first_child();
     // Make sure we are at a valid successor.
     while (child != nullptr && !child->valid()) {
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
     if (child == nullptr) {
         return nullptr;
@@ -400,10 +823,10 @@ UCTNode* UCTNode::uct_select_child(int color) {
             best = child;
         }
 
-        child = child->m_nextsibling;
+        child = child->get_sibling();
         // Make sure we are at a valid successor.
         while (child != nullptr && !child->valid()) {
-            child = child->m_nextsibling;
+            child = child->get_sibling();
         }
         childcount++;
     }
@@ -457,81 +880,125 @@ public:
     }
 };
 
-/*
-    sort children by converting linked list to vector,
-    sorting the vector, and reconstructing to linked list again
-    Requires node mutex to be held.
-*/
-void UCTNode::sort_children() {
-    assert(get_mutex().is_held());
-    std::vector<std::tuple<float, UCTNode*>> tmp;
-
-    UCTNode * child = m_firstchild;
+void UCTNode::sort_root_children(int color) {
+    LOCK(get_mutex(), lock);
+    auto tmp = std::vector<sortnode_t>{};
 
-    while (child != nullptr) {
-        tmp.emplace_back(child->get_score(), child);
-        child = child->m_nextsibling;
+    auto index = m_firstchild;
+    while (index != 0) {
+        auto child = get_node(index);
+        auto visits = child->get_visits();
+        auto score = child->get_score();
+        if (visits) {
+            auto winrate = child->get_eval(color);
+            tmp.emplace_back(winrate, visits, score, index);
+        } else {
+            tmp.emplace_back(0.0f, 0, score, index);
+        }
+        index = child->m_nextsibling;
     }
 
-    std::sort(begin(tmp), end(tmp));
+    // reverse sort, because list reconstruction is backwards
+    std::stable_sort(rbegin(tmp), rend(tmp), NodeComp());
 
-    m_firstchild = nullptr;
+    m_firstchild = 0;
 
     for (auto& sortnode : tmp) {
-        link_child(std::get<1>(sortnode));
+        link_child(std::get<3>(sortnode));
     }
 }
 
-void UCTNode::sort_root_children(int color) {
-    LOCK(get_mutex(), lock);
-    auto tmp = std::vector<sortnode_t>{};
+/*
+    Valid children in the order sort_root_children() would put them
+    in, best first, without changing the tree.
+*/
+std::vector<UCTNode*> UCTNode::get_sorted_children(int color) const {
+    auto sorted = std::vector<UCTNode*>{};
+    if (!has_children()) {
+        return sorted;
+    }
 
-    auto child = m_firstchild;
-    while (child != nullptr) {
+    auto tmp = std::vector<sortnode_t>{};
+    for (auto index = m_firstchild; index != 0;
+         index = get_node(index)->m_nextsibling) {
+        auto child = get_node(index);
+        if (!child->valid()) {
+            continue;
+        }
         auto visits = child->get_visits();
         auto score = child->get_score();
         if (visits) {
-            auto winrate = child->get_eval(color);
-            tmp.emplace_back(winrate, visits, score, child);
+            tmp.emplace_back(child->get_eval(color), visits, score, index);
         } else {
-            tmp.emplace_back(0.0f, 0, score, child);
+            tmp.emplace_back(0.0f, 0, score, index);
         }
-        child = child->m_nextsibling;
     }
 
-    // reverse sort, because list reconstruction is backwards
-    std::stable_sort(rbegin(tmp), rend(tmp), NodeComp());
-
-    m_firstchild = nullptr;
+    std::stable_sort(begin(tmp), end(tmp), NodeComp());
 
     for (auto& sortnode : tmp) {
-        link_child(std::get<3>(sortnode));
+        sorted.emplace_back(get_node(std::get<3>(sortnode)));
     }
+    return sorted;
 }
 
 UCTNode* UCTNode::get_first_child() const {
-    return m_firstchild;
+    return get_node(m_firstchild);
+}
+
+/*
+    Most visited valid child, ties broken on eval. It only reads the
+    tree, so it can be used while the search is running.
+*/
+UCTNode* UCTNode::get_best_child(int color) const {
+    // The child links are complete once the flag is set.
+    if (!has_children()) {
+        return nullptr;
+    }
+
+    UCTNode * best = nullptr;
+    auto best_visits = 0;
+    auto best_eval = 0.0f;
+
+    for (auto child = get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        if (!child->valid()) {
+            continue;
+        }
+        auto visits = child->get_visits();
+        if (visits == 0 || visits < best_visits) {
+            continue;
+        }
+        auto eval = child->get_eval(color);
+        if (visits > best_visits || eval > best_eval) {
+            best = child;
+            best_visits = visits;
+            best_eval = eval;
+        }
+    }
+
+    return best;
 }
 
 UCTNode* UCTNode::get_sibling() const {
-    return m_nextsibling;
+    return get_node(m_nextsibling);
 }
 
 UCTNode* UCTNode::get_pass_child() const {
-    UCTNode * child = m_firstchild;
+    UCTNode * child = get_first_child();
 
     while (child != nullptr) {
         if (child->m_move == FastBoard::PASS) {
             return child;
         }
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 
     return nullptr;
 }
 
 UCTNode* UCTNode::get_nopass_child(FastState& state) const {
-    UCTNode * child = m_firstchild;
+    UCTNode * child = get_first_child();
 
     while (child != nullptr) {
         /* If we prevent the engine from passing, we must bail out when
@@ -542,45 +1009,44 @@ UCTNode* UCTNode::get_nopass_child(FastState& state) const {
             && !state.board.is_eye(state.get_to_move(), child->m_move)) {
             return child;
         }
-        child = child->m_nextsibling;
+        child = child->get_sibling();
     }
 
     return nullptr;
 }
 
 void UCTNode::invalidate() {
-    m_valid = false;
+    m_flags |= INVALID;
 }
 
 bool UCTNode::valid() const {
-    return m_valid;
+    return !(m_flags & INVALID);
 }
 
 // unsafe in SMP, we don't know if people hold pointers to the
 // child which they might dereference
-void UCTNode::delete_child(UCTNode * del_child) {
+int UCTNode::delete_child(UCTNode * del_child) {
     LOCK(get_mutex(), lock);
     assert(del_child != nullptr);
 
-    if (del_child == m_firstchild) {
-        m_firstchild = m_firstchild->m_nextsibling;
-        delete del_child;
-        return;
-    } else {
-        UCTNode * child = m_firstchild;
-        UCTNode * prev  = nullptr;
-
-        do {
-            prev  = child;
-            child = child->m_nextsibling;
+    auto child = m_firstchild;
+    UCTNode * prev = nullptr;
 
-            if (child == del_child) {
-                prev->m_nextsibling = child->m_nextsibling;
-                delete del_child;
-                return;
+    while (child != 0) {
+        auto node = get_node(child);
+        if (node == del_child) {
+            if (prev == nullptr) {
+                m_firstchild = node->m_nextsibling;
+            } else {
+                prev->m_nextsibling = node->m_nextsibling;
             }
-        } while (child != nullptr);
+            node->m_nextsibling = 0;
+            return release_nodes(child);
+        }
+        prev  = node;
+        child = node->m_nextsibling;
     }
 
     assert(false && "Child to delete not found");
+    return 0;
 }
@@ -24,6 +24,7 @@
 #include <tuple>
 #include <atomic>
 #include <limits>
+#include <iosfwd>
 
 #include "SMP.h"
 #include "GameState.h"
@@ -31,21 +32,29 @@
 
 class UCTNode {
 public:
-    using sortnode_t = std::tuple<float, int, float, UCTNode*>;
+    using sortnode_t = std::tuple<float, int, float, uint32>;
 
     // When we visit a node, add this amount of virtual losses
     // to it to encourage other CPUs to explore other parts of the
     // search tree.
     static constexpr auto VIRTUAL_LOSS_COUNT = 3;
 
+    /*
+        Nodes live in a global pool and refer to each other
+        by 32-bit index, 0 is no node.
+    */
+    static constexpr size_t MAX_NODES = std::numeric_limits<uint32>::max();
+
     explicit UCTNode(int vertex, float score);
     ~UCTNode();
     bool first_visit() const;
     bool has_children() const;
     bool create_children(std::atomic<int> & nodecount,
-                         GameState & state, float & eval);
-    void kill_superkos(KoState & state);
-    void delete_child(UCTNode * child);
+                         GameState & state, float & eval,
+                         Network::Ensemble ensemble
+                             = Network::Ensemble::RANDOM_ROTATION);
+    int kill_superkos(KoState & state);
+    int delete_child(UCTNode * child);
     void invalidate();
     bool valid() const;
     int get_move() const;
@@ -54,10 +63,9 @@ public:
     void set_score(float score);
     float get_eval(int tomove) const;
     double get_blackevals() const;
-    void set_visits(int visits);
-    void set_blackevals(double blacevals);
     void set_eval(float eval);
     void accumulate_eval(float eval);
+    void set_stats(int visits, float blackeval);
     void virtual_loss(void);
     void virtual_loss_undo(void);
     void dirichlet_noise(float epsilon, float alpha);
@@ -66,37 +74,58 @@ public:
 
     UCTNode* uct_select_child(int color);
     UCTNode* get_first_child() const;
+    UCTNode* get_best_child(int color) const;
     UCTNode* get_pass_child() const;
     UCTNode* get_nopass_child(FastState& state) const;
     UCTNode* get_sibling() const;
 
+    int prune_subtrees(int min_visits);
+    int unexpand();
+    void release_children();
+    bool promote_child(int move);
+    int count_nodes() const;
+
+    void save_tree(std::ostream & out) const;
+    bool load_tree(std::istream & in, KoState & state,
+                   std::atomic<int> & nodecount, int maxnodes);
+
     void sort_root_children(int color);
-    void sort_children();
+    std::vector<UCTNode*> get_sorted_children(int color) const;
     SMP::Mutex & get_mutex();
 
 private:
+    enum Flags : uint8 {
+        HAS_CHILDREN = 1 << 0,
+        INVALID      = 1 << 1,
+        EXPANDING    = 1 << 2
+    };
+
     UCTNode();
-    void link_child(UCTNode * newchild);
+    static UCTNode* get_node(uint32 index);
+    static int release_nodes(uint32 first);
+    void link_child(uint32 newchild);
+    void save_children(std::ostream & out) const;
+    bool load_children(std::istream & in, uint16 count, KoState & state,
+                       std::atomic<int> & nodecount, int maxnodes);
+    void write_stats(std::ostream & out) const;
+    bool read_stats(std::istream & in);
     void link_nodelist(std::atomic<int> & nodecount,
                        std::vector<Network::scored_node> & nodelist);
 
     // Tree data
-    std::atomic<bool> m_has_children{false};
-    UCTNode* m_firstchild{nullptr};
-    UCTNode* m_nextsibling{nullptr};
+    uint32 m_firstchild{0};
+    uint32 m_nextsibling{0};
+    // UCT: visits in the high half, the bits of the mean eval from
+    // black's point of view in the low half. A running mean keeps its
+    // precision where a float sum would not, and updating both in one
+    // CAS keeps them consistent with each other.
+    std::atomic<uint64> m_stats{0};
     // Move
-    int m_move;
-    // UCT
-    std::atomic<int> m_visits{0};
-    std::atomic<int> m_virtual_loss{0};
-    // UCT eval
-    float m_score;
-    std::atomic<double> m_blackevals{0};
-    // node alive (not superko)
-    std::atomic<bool> m_valid{true};
-    // Is someone adding scores to this node?
-    // We don't need to unset this.
-    bool m_is_expanding{false};
+    int16 m_move;
+    std::atomic<int16> m_virtual_loss{0};
+    // Prior, fixed point in 1/65535
+    uint16 m_score;
+    std::atomic<uint8> m_flags{0};
     SMP::Mutex m_nodemutex;
 };
 
@@ -20,12 +20,14 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <array>
 #include <cmath>
 #include <vector>
 #include <utility>
 #include <thread>
 #include <algorithm>
 #include <type_traits>
+#include <fstream>
 
 #include "FastBoard.h"
 #include "UCTSearch.h"
@@ -34,8 +36,8 @@
 #include "Utils.h"
 #include "Network.h"
 #include "GTP.h"
-#include "TTable.h"
 #include "Training.h"
+#include "Zobrist.h"
 #ifdef USE_OPENCL
 #include "OpenCL.h"
 #endif
@@ -45,19 +47,54 @@ using namespace Utils;
 UCTSearch::UCTSearch(GameState & g)
     : m_rootstate(g) {
     set_playout_limit(cfg_max_playouts);
+    set_threads(cfg_num_threads);
+    set_max_memory(cfg_max_memory);
+}
+
+void UCTSearch::set_threads(int threads) {
+    m_threads = std::max(1, threads);
+}
+
+/*
+    Whether think() records its search for training. Searches that
+    aren't recorded get no root noise either, so that they play the
+    best move they can find.
+*/
+void UCTSearch::set_recording(bool flag) {
+    m_recording = flag;
+}
+
+/*
+    Whether think() and ponder() continue from the subtree of the
+    moves played since the last search, instead of starting over.
+    The carried over visits end up in the recorded training data.
+*/
+void UCTSearch::set_tree_reuse(bool flag) {
+    m_tree_reuse = flag;
+}
+
+/*
+    Tree memory budget in MiB.
+*/
+void UCTSearch::set_max_memory(int max_memory) {
+    auto max_bytes = static_cast<size_t>(std::max(1, max_memory)) * 1024 * 1024;
+    auto max_nodes = std::min(max_bytes / NODE_MEMORY, UCTNode::MAX_NODES);
+    m_maxnodes = static_cast<int>(std::min<size_t>(
+        max_nodes, std::numeric_limits<int>::max()));
 }
 
 SearchResult UCTSearch::play_simulation(GameState & currstate, UCTNode* const node) {
     const auto color = currstate.get_to_move();
-    const auto hash = currstate.board.get_hash();
+    // Symmetric positions share their statistics
+    const auto hash = currstate.board.get_canonical_hash();
     const auto komi = currstate.get_komi();
 
     auto result = SearchResult{};
 
-    TTable::get_TT()->sync(hash, komi, node);
+    m_ttable.sync(hash, komi, node);
     node->virtual_loss();
 
-    if (!node->has_children() && m_nodes < MAX_TREE_SIZE) {
+    if (!node->has_children() && m_nodes < m_maxnodes) {
         float eval;
         auto success = node->create_children(m_nodes, currstate, eval);
         if (success) {
@@ -65,13 +102,22 @@ SearchResult UCTSearch::play_simulation(GameState & currstate, UCTNode* const no
         } else if (currstate.get_passes() >= 2) {
             auto score = currstate.final_score();
             result = SearchResult::from_score(score);
+        } else if (!node->has_children()) {
+            m_collisions++;
+            result = SearchResult::from_collision();
         }
     }
 
-    if (node->has_children() && !result.valid()) {
-        auto next = node->uct_select_child(color);
-
-        if (next != nullptr) {
+    if (node->has_children() && !result.valid() && !result.collided()) {
+        // A child whose leaf collided keeps an extra virtual loss
+        // while we retry, so that uct_select_child looks elsewhere.
+        std::array<UCTNode*, MAX_COLLISION_RETRIES> collided;
+        auto retries = 0;
+        for (;;) {
+            auto next = node->uct_select_child(color);
+            if (next == nullptr) {
+                break;
+            }
             auto move = next->get_move();
 
             if (move != FastBoard::PASS) {
@@ -86,6 +132,20 @@ SearchResult UCTSearch::play_simulation(GameState & currstate, UCTNode* const no
                 currstate.play_pass();
                 result = play_simulation(currstate, next);
             }
+
+            if (!result.collided() || retries == MAX_COLLISION_RETRIES) {
+                break;
+            }
+            currstate.undo_move();
+            next->virtual_loss();
+            collided[retries++] = next;
+        }
+        for (auto i = 0; i < retries; i++) {
+            collided[i]->virtual_loss_undo();
+        }
+        // Only the leaf's parent retries.
+        if (result.collided()) {
+            result = SearchResult{};
         }
     }
 
@@ -93,7 +153,7 @@ SearchResult UCTSearch::play_simulation(GameState & currstate, UCTNode* const no
         node->update(result.eval());
     }
     node->virtual_loss_undo();
-    TTable::get_TT()->update(hash, komi, node);
+    m_ttable.update(hash, komi, node);
 
     return result;
 }
@@ -101,23 +161,13 @@ SearchResult UCTSearch::play_simulation(GameState & currstate, UCTNode* const no
 void UCTSearch::dump_stats(KoState & state, UCTNode & parent) {
     const int color = state.get_to_move();
 
-    if (!parent.has_children()) {
-        return;
-    }
-
-    // sort children, put best move on top
-    m_root.sort_root_children(color);
-
-    UCTNode * bestnode = parent.get_first_child();
-
-    if (bestnode->first_visit()) {
+    auto children = parent.get_sorted_children(color);
+    if (children.empty() || children.front()->first_visit()) {
         return;
     }
 
     int movecount = 0;
-    UCTNode * node = bestnode;
-
-    while (node != nullptr) {
+    for (auto node : children) {
         if (++movecount > 2 && !node->get_visits()) break;
 
         std::string tmp = state.move_to_text(node->get_move());
@@ -129,14 +179,9 @@ void UCTSearch::dump_stats(KoState & state, UCTNode & parent) {
             node->get_visits() > 0 ? node->get_eval(color)*100.0f : 0.0f,
             node->get_score() * 100.0f);
 
-        KoState tmpstate = state;
-
-        tmpstate.play_move(node->get_move());
-        pvstring += " " + get_pv(tmpstate, *node);
+        pvstring += " " + get_best_line(*node, !color);
 
         myprintf("%s\n", pvstring.c_str());
-
-        node = node->get_sibling();
     }
 }
 
@@ -263,44 +308,85 @@ int UCTSearch::get_best_move(passflag_t passflag) {
     return bestmove;
 }
 
-std::string UCTSearch::get_pv(KoState & state, UCTNode & parent) {
-    if (!parent.has_children()) {
-        return std::string();
-    }
-
-    // This temporarily breaks any best probability = first in tree assumptions
-    parent.sort_root_children(state.get_to_move());
-
-    LOCK(parent.get_mutex(), lock);
-    UCTNode * bestchild = parent.get_first_child();
-    int bestmove = bestchild->get_move();
-    lock.unlock();
-
-    std::string tmp = state.move_to_text(bestmove);
-
-    std::string res(tmp);
-    res.append(" ");
+void UCTSearch::dump_analysis(int playouts) {
+    int color = m_rootstate.board.get_to_move();
 
-    state.play_move(bestmove);
+    std::string pvstring = get_best_line(m_root, color);
+    float winrate = 100.0f * m_root.get_eval(color);
+    myprintf("Playouts: %d, Win: %5.2f%%, PV: %s\n",
+             playouts, winrate, pvstring.c_str());
+}
 
-    std::string next = get_pv(state, *bestchild);
-    res.append(next);
+/*
+    Line of most visited moves, without playing them out or
+    touching the tree.
+*/
+std::string UCTSearch::get_best_line(UCTNode & parent, int color) {
+    auto res = std::string{};
+    auto node = parent.get_best_child(color);
 
-    // Resort according to move probability
-    lock.lock();
-    parent.sort_children();
+    while (node != nullptr) {
+        if (!res.empty()) {
+            res.append(" ");
+        }
+        res.append(m_rootstate.move_to_text(node->get_move()));
+        color = !color;
+        node = node->get_best_child(color);
+    }
 
     return res;
 }
 
-void UCTSearch::dump_analysis(int playouts) {
-    GameState tempstate = m_rootstate;
-    int color = tempstate.board.get_to_move();
+/*
+    One line with visits, winrate and prior (both in 1/10000) and
+    the PV of every visited root move, best first. Only reads the
+    tree, so the workers keep running.
+*/
+void UCTSearch::output_analysis() {
+    const auto color = m_rootstate.get_to_move();
+    if (!m_root.has_children()) {
+        return;
+    }
 
-    std::string pvstring = get_pv(tempstate, m_root);
-    float winrate = 100.0f * m_root.get_eval(color);
-    myprintf("Playouts: %d, Win: %5.2f%%, PV: %s\n",
-             playouts, winrate, pvstring.c_str());
+    // Snapshot the counters, so that the sort sees fixed values.
+    auto moves = std::vector<std::tuple<int, float, UCTNode*>>{};
+    for (auto child = m_root.get_first_child(); child != nullptr;
+         child = child->get_sibling()) {
+        auto visits = child->get_visits();
+        if (child->valid() && visits > 0) {
+            moves.emplace_back(visits, child->get_eval(color), child);
+        }
+    }
+    std::sort(rbegin(moves), rend(moves),
+        [](const std::tuple<int, float, UCTNode*> & a,
+           const std::tuple<int, float, UCTNode*> & b) {
+            return std::tie(std::get<0>(a), std::get<1>(a))
+                 < std::tie(std::get<0>(b), std::get<1>(b));
+        });
+
+    auto line = std::string{};
+    auto order = 0;
+    for (const auto & move : moves) {
+        auto node = std::get<2>(move);
+        auto vertex = m_rootstate.move_to_text(node->get_move());
+        auto pv = vertex;
+        auto rest = get_best_line(*node, !color);
+        if (!rest.empty()) {
+            pv += " " + rest;
+        }
+        if (!line.empty()) {
+            line += " ";
+        }
+        line += "info move " + vertex
+              + " visits " + std::to_string(std::get<0>(move))
+              + " winrate " + std::to_string(
+                  static_cast<int>(std::get<1>(move) * 10000.0f))
+              + " prior " + std::to_string(
+                  static_cast<int>(node->get_score() * 10000.0f))
+              + " order " + std::to_string(order++)
+              + " pv " + pv;
+    }
+    gtp_line_printf("%s", line.c_str());
 }
 
 bool UCTSearch::is_running() const {
@@ -311,12 +397,228 @@ bool UCTSearch::playout_limit_reached() const {
     return m_playouts >= m_maxplayouts;
 }
 
+/*
+    Best root move by visits, its visits, and the visits
+    of the runner-up.
+*/
+std::tuple<int, int, int> UCTSearch::get_root_leaders() const {
+    int bestmove = FastBoard::PASS;
+    int bestvisits = 0;
+    int secondvisits = 0;
+
+    auto child = m_root.get_first_child();
+    while (child != nullptr) {
+        if (child->valid()) {
+            auto visits = child->get_visits();
+            if (visits > bestvisits) {
+                secondvisits = bestvisits;
+                bestvisits = visits;
+                bestmove = child->get_move();
+            } else if (visits > secondvisits) {
+                secondvisits = visits;
+            }
+        }
+        child = child->get_sibling();
+    }
+
+    return std::make_tuple(bestmove, bestvisits, secondvisits);
+}
+
+/*
+    How many more playouts we can expect before the time
+    or playout limit is hit, at the speed seen so far.
+*/
+int UCTSearch::est_playouts_left(int elapsed_centis, int time_for_move) const {
+    auto playouts = m_playouts.load();
+    auto playouts_left = std::max(0, m_maxplayouts - playouts);
+
+    // Not enough data for a speed estimate yet.
+    if (elapsed_centis < TIME_CHECK_INTERVAL) {
+        return playouts_left;
+    }
+    auto playout_rate = static_cast<double>(playouts) / elapsed_centis;
+    auto time_left = std::max(0, time_for_move - elapsed_centis);
+    auto time_playouts = std::ceil(playout_rate * time_left);
+    return static_cast<int>(std::min<double>(playouts_left, time_playouts));
+}
+
+/*
+    Prune when the tree gets close to the memory budget, so that
+    the workers never find it full. When pruning could not get far
+    enough below the budget, wait until the tree has grown by a tenth
+    of it again instead of stopping the search on every playout.
+*/
+bool UCTSearch::should_prune_tree() const {
+    return m_nodes > m_maxnodes - m_maxnodes / 10
+        && m_nodes - m_pruned_nodes >= m_maxnodes / 10;
+}
+
+void UCTSearch::prune_tree(ThreadGroup & tg) {
+    // Stop the world, nobody may hold pointers into the tree.
+    m_run = false;
+    tg.wait_all();
+
+    // A node with more visits than the root has would never be pruned,
+    // so the last round unexpands every root child.
+    auto target = m_maxnodes - m_maxnodes / 4;
+    auto max_visits = m_root.get_visits() + 1;
+    auto min_visits = std::min(2, max_visits);
+    for (;;) {
+        auto freed = m_root.prune_subtrees(min_visits);
+        m_nodes -= freed;
+        if (m_nodes <= target || min_visits == max_visits) {
+            break;
+        }
+        min_visits = std::min(min_visits * 2, max_visits);
+    }
+    m_pruned_nodes = m_nodes;
+    myprintf("Pruned tree to %d nodes (%d MiB), visits < %d.\n",
+             static_cast<int>(m_nodes),
+             static_cast<int>((m_nodes * NODE_MEMORY) / (1024 * 1024)),
+             min_visits);
+
+    m_run = true;
+    int cpus = m_threads;
+    for (int i = 1; i < cpus; i++) {
+        tg.add_task(UCTWorker(m_rootstate, this, &m_root));
+    }
+}
+
+/*
+    Identifies the position the tree is searching. The board hash
+    does not follow set_to_move() and leaves out the ko square, so
+    mix those in with keys the board hash never uses.
+*/
+uint64 UCTSearch::get_root_hash() const {
+    return get_position_hash(m_rootstate);
+}
+
+uint64 UCTSearch::get_position_hash(GameState & state) {
+    auto hash = state.board.get_hash();
+    hash ^= Zobrist::zobrist[FastBoard::INVAL][state.get_komove()];
+    if (state.get_to_move() == FastBoard::WHITE) {
+        hash ^= Zobrist::zobrist[FastBoard::INVAL][FastBoard::MAXSQ - 1];
+    }
+    return hash;
+}
+
+bool UCTSearch::tree_matches_root() const {
+    return m_treehash == get_root_hash()
+        && m_treekomi == m_rootstate.get_komi();
+}
+
+/*
+    If the tree was built a few moves before the current position,
+    keep the subtree of the moves that were played, with its visits.
+    Only the search counters start over.
+*/
+bool UCTSearch::advance_tree() {
+    if (!m_tree_reuse || !m_root.has_children()
+        || m_treekomi != m_rootstate.get_komi()) {
+        return false;
+    }
+
+    // Walk back through the game to the position of the tree.
+    auto state = std::make_unique<GameState>(m_rootstate);
+    auto moves = std::vector<int>{};
+    do {
+        if (moves.size() == MAX_TREE_ADVANCE) {
+            return false;
+        }
+        auto move = state->get_last_move();
+        if (!state->undo_move()) {
+            return false;
+        }
+        moves.emplace_back(move);
+    } while (get_position_hash(*state) != m_treehash);
+
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it) {
+        if (!m_root.promote_child(*it)) {
+            return false;
+        }
+    }
+    m_nodes = m_root.count_nodes();
+    m_pruned_nodes = 0;
+    m_treehash = get_root_hash();
+    return true;
+}
+
+/*
+    Throw away the tree and start a new one at the current position.
+    The old nodes are freed in the background.
+*/
+void UCTSearch::clear_tree() {
+    m_root.release_children();
+    m_nodes = 0;
+    m_pruned_nodes = 0;
+    m_root.set_stats(0, 0.0f);
+    m_treehash = get_root_hash();
+    m_treekomi = m_rootstate.get_komi();
+}
+
+bool UCTSearch::save_tree(const std::string & filename) {
+    if (!m_root.has_children() || !tree_matches_root()) {
+        myprintf("No search tree for this position.\n");
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    auto magic = TREE_MAGIC;
+    auto version = TREE_VERSION;
+    out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&m_treehash), sizeof(m_treehash));
+    out.write(reinterpret_cast<const char*>(&m_treekomi), sizeof(m_treekomi));
+    m_root.save_tree(out);
+    out.close();
+
+    if (out.fail()) {
+        myprintf("Error writing %s.\n", filename.c_str());
+        return false;
+    }
+    myprintf("Saved %d nodes, %d visits.\n",
+             static_cast<int>(m_nodes), m_root.get_visits());
+    return true;
+}
+
+bool UCTSearch::load_tree(const std::string & filename) {
+    std::ifstream in(filename, std::ios::binary);
+    uint32 magic, version;
+    uint64 hash;
+    float komi;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    in.read(reinterpret_cast<char*>(&komi), sizeof(komi));
+    if (!in || magic != TREE_MAGIC || version != TREE_VERSION) {
+        myprintf("%s is not a saved search tree.\n", filename.c_str());
+        return false;
+    }
+    if (hash != get_root_hash() || komi != m_rootstate.get_komi()) {
+        myprintf("Tree was saved for a different position.\n");
+        return false;
+    }
+
+    clear_tree();
+    KoState state = m_rootstate;
+    if (!m_root.load_tree(in, state, m_nodes, m_maxnodes)) {
+        myprintf("Tree is damaged or does not fit in --maxmemory.\n");
+        clear_tree();
+        return false;
+    }
+    myprintf("Loaded %d nodes, %d visits.\n",
+             static_cast<int>(m_nodes), m_root.get_visits());
+    return true;
+}
+
 void UCTWorker::operator()() {
     do {
         auto currstate = std::make_unique<GameState>(m_rootstate);
         auto result = m_search->play_simulation(*currstate, m_root);
         if (result.valid()) {
             m_search->increment_playouts();
+        } else {
+            m_search->increment_wasted();
         }
     } while(m_search->is_running() && !m_search->playout_limit_reached());
 }
@@ -325,30 +627,61 @@ void UCTSearch::increment_playouts() {
     m_playouts++;
 }
 
-int UCTSearch::think(int color, passflag_t passflag) {
-    assert(m_playouts == 0);
-    assert(m_nodes == 0);
+void UCTSearch::increment_wasted() {
+    m_wasted++;
+}
+
+UCTSearch::Stats UCTSearch::get_stats() {
+    auto tt = m_ttable.get_stats();
+    tt.lookups -= m_ttstart.lookups;
+    tt.hits -= m_ttstart.hits;
+    return {m_playouts, m_collisions, m_wasted, m_nodes, tt};
+}
 
+int UCTSearch::think(int color, passflag_t passflag) {
     // Start counting time for us
     m_rootstate.start_clock(color);
 
     // set side to move
     m_rootstate.board.set_to_move(color);
 
+    // Continue from an earlier or loaded tree of this position,
+    // or from the subtree of the moves played since
+    if (!tree_matches_root() && !advance_tree()) {
+        clear_tree();
+    }
+    m_playouts = 0;
+    m_collisions = 0;
+    m_wasted = 0;
+    m_ttstart = m_ttable.get_stats();
+
     // set up timing info
     Time start;
 
     m_rootstate.get_timecontrol().set_boardsize(m_rootstate.board.get_boardsize());
     auto time_for_move = m_rootstate.get_timecontrol().max_time_for_move(color);
+    // Self-play wants a fixed amount of search per move.
+    auto max_time_for_move = time_for_move;
+    if (!cfg_noise) {
+        max_time_for_move =
+            m_rootstate.get_timecontrol().max_extended_time_for_move(color);
+    }
 
     myprintf("Thinking at most %.1f seconds...\n", time_for_move/100.0f);
 
     // create a sorted list off legal moves (make sure we
     // play something legal and decent even in time trouble)
+    // The root is evaluated once per move, so average all symmetries.
     float root_eval;
-    m_root.create_children(m_nodes, m_rootstate, root_eval);
-    m_root.kill_superkos(m_rootstate);
-    if (cfg_noise) {
+    auto expanded = m_root.create_children(m_nodes, m_rootstate, root_eval,
+                                           Network::Ensemble::AVERAGE);
+    if (!expanded) {
+        // Reused tree, the root was expanded before
+        root_eval = m_root.get_eval(FastBoard::BLACK);
+    }
+    m_nodes -= m_root.kill_superkos(m_rootstate);
+    // A reused root keeps the noise it got, don't pile more on.
+    if (expanded && cfg_noise && m_recording) {
         m_root.dirichlet_noise(0.25f, 0.03f);
     }
 
@@ -356,7 +689,7 @@ int UCTSearch::think(int color, passflag_t passflag) {
              (color == FastBoard::BLACK ? root_eval : 1.0f - root_eval));
 
     m_run = true;
-    int cpus = cfg_num_threads;
+    int cpus = m_threads;
     ThreadGroup tg(thread_pool);
     for (int i = 1; i < cpus; i++) {
         tg.add_task(UCTWorker(m_rootstate, this, &m_root));
@@ -364,12 +697,21 @@ int UCTSearch::think(int color, passflag_t passflag) {
 
     bool keeprunning = true;
     int last_update = 0;
+    int last_check = 0;
+    int time_limit = time_for_move;
+    int last_bestmove = FastBoard::PASS;
+    int bestmove_changed = 0;
     do {
         auto currstate = std::make_unique<GameState>(m_rootstate);
 
         auto result = play_simulation(*currstate, &m_root);
         if (result.valid()) {
             increment_playouts();
+        } else {
+            increment_wasted();
+        }
+        if (should_prune_tree()) {
+            prune_tree(tg);
         }
 
         Time elapsed;
@@ -382,7 +724,44 @@ int UCTSearch::think(int color, passflag_t passflag) {
             dump_analysis(static_cast<int>(m_playouts));
         }
         keeprunning  = is_running();
-        keeprunning &= (centiseconds_elapsed < time_for_move);
+
+        // check whether the search can still change its mind
+        if (!cfg_noise
+            && centiseconds_elapsed - last_check >= TIME_CHECK_INTERVAL) {
+            last_check = centiseconds_elapsed;
+
+            int bestmove, bestvisits, secondvisits;
+            std::tie(bestmove, bestvisits, secondvisits) = get_root_leaders();
+            if (bestmove != last_bestmove) {
+                last_bestmove = bestmove;
+                bestmove_changed = centiseconds_elapsed;
+            }
+
+            auto playouts_left = est_playouts_left(centiseconds_elapsed,
+                                                   time_limit);
+            if (bestvisits - secondvisits > playouts_left) {
+                myprintf("%d playouts left, stopping early.\n",
+                         playouts_left);
+                keeprunning = false;
+            }
+
+            // out of normal time, keep going if the decision is unclear
+            if (centiseconds_elapsed >= time_for_move) {
+                auto close = secondvisits * 4 > bestvisits * 3;
+                auto unstable = centiseconds_elapsed - bestmove_changed
+                                < time_for_move / 4;
+                if ((close || unstable)
+                    && time_limit != max_time_for_move) {
+                    myprintf("Unclear position, extending search.\n");
+                    time_limit = max_time_for_move;
+                }
+                if (!close && !unstable) {
+                    time_limit = time_for_move;
+                }
+            }
+        }
+
+        keeprunning &= (centiseconds_elapsed < time_limit);
         keeprunning &= !playout_limit_reached();
     } while(keeprunning);
 
@@ -398,36 +777,72 @@ int UCTSearch::think(int color, passflag_t passflag) {
     myprintf("\n");
 
     dump_stats(m_rootstate, m_root);
-    Training::record(m_rootstate, m_root);
+    if (m_recording) {
+        Training::record(m_rootstate, m_root);
+    }
 
     Time elapsed;
     int centiseconds_elapsed = Time::timediff(start, elapsed);
     if (centiseconds_elapsed > 0) {
-        myprintf("%d visits, %d nodes, %d playouts, %d n/s\n\n",
+        myprintf("%d visits, %d nodes, %d playouts, %d n/s\n",
                  m_root.get_visits(),
                  static_cast<int>(m_nodes),
                  static_cast<int>(m_playouts),
                  (m_playouts * 100) / (centiseconds_elapsed+1));
+        // Descents either become a playout or are wasted.
+        auto descents = std::max(1, m_playouts + m_wasted);
+        myprintf("%d collisions, %d wasted descents, %.1f%% useful\n\n",
+                 static_cast<int>(m_collisions),
+                 static_cast<int>(m_wasted),
+                 100.0f * m_playouts / descents);
     }
     int bestmove = get_best_move(passflag);
     return bestmove;
 }
 
-void UCTSearch::ponder() {
-    assert(m_playouts == 0);
-    assert(m_nodes == 0);
+/*
+    Search until input arrives. With an analysis interval (in
+    centiseconds) the state of the search is written to stdout
+    that often.
+*/
+void UCTSearch::ponder(int analysis_interval) {
+    if (!tree_matches_root() && !advance_tree()) {
+        clear_tree();
+    }
+    m_playouts = 0;
+    m_collisions = 0;
+    m_wasted = 0;
+    m_ttstart = m_ttable.get_stats();
+
+    // Analysis quality matters more than speed at the root
+    float root_eval;
+    m_root.create_children(m_nodes, m_rootstate, root_eval,
+                           Network::Ensemble::AVERAGE);
 
     m_run = true;
-    int cpus = cfg_num_threads;
+    int cpus = m_threads;
     ThreadGroup tg(thread_pool);
     for (int i = 1; i < cpus; i++) {
         tg.add_task(UCTWorker(m_rootstate, this, &m_root));
     }
+    Time last_output;
     do {
         auto currstate = std::make_unique<GameState>(m_rootstate);
         auto result = play_simulation(*currstate, &m_root);
         if (result.valid()) {
             increment_playouts();
+        } else {
+            increment_wasted();
+        }
+        if (should_prune_tree()) {
+            prune_tree(tg);
+        }
+        if (analysis_interval > 0) {
+            Time now;
+            if (Time::timediff(last_output, now) >= analysis_interval) {
+                last_output = now;
+                output_analysis();
+            }
         }
     } while(!Utils::input_pending() && is_running());
 
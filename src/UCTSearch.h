@@ -22,15 +22,25 @@
 #include <memory>
 #include <atomic>
 #include <tuple>
+#include <string>
 
 #include "GameState.h"
+#include "TTable.h"
 #include "UCTNode.h"
+#include "ThreadPool.h"
 
 class SearchResult {
 public:
     SearchResult() = default;
     bool valid() const { return m_valid;  }
+    // The leaf was being expanded by another thread.
+    bool collided() const { return m_collided; }
     float eval() const { return m_eval;  }
+    static SearchResult from_collision() {
+        auto result = SearchResult{};
+        result.m_collided = true;
+        return result;
+    }
     static SearchResult from_eval(float eval) {
         return SearchResult(eval);
     }
@@ -47,6 +57,7 @@ private:
     explicit SearchResult(float eval)
         : m_valid(true), m_eval(eval) {};
     bool m_valid{false};
+    bool m_collided{false};
     float m_eval{0.0f};
 };
 
@@ -63,34 +74,104 @@ public:
     static constexpr passflag_t NORESIGN = 1 << 1;
 
     /*
-        Maximum size of the tree in memory. Nodes are about
-        40 bytes, so limit to ~1.6G.
+        Memory taken by a tree node. Nodes come from a pool,
+        so there is no allocator overhead.
+    */
+    static constexpr size_t NODE_MEMORY = sizeof(UCTNode);
+
+    /*
+        Centiseconds between checks whether the best move
+        can still be overtaken.
+    */
+    static constexpr auto TIME_CHECK_INTERVAL = 10;
+
+    /*
+        How often a descent that runs into a leaf being expanded by
+        another thread picks a different child of the leaf's parent,
+        before it gives up.
+    */
+    static constexpr auto MAX_COLLISION_RETRIES = 3;
+
+    /*
+        How many moves, our own and the opponent's reply, the tree
+        can be followed down to reach the new root.
+    */
+    static constexpr size_t MAX_TREE_ADVANCE = 2;
+
+    /*
+        Header of a saved search tree: "LZTR" and the format version.
+    */
+    static constexpr uint32 TREE_MAGIC = 0x52545a4c;
+    static constexpr uint32 TREE_VERSION = 1;
+
+    /*
+        Counters of the last think() or ponder().
     */
-    static constexpr auto MAX_TREE_SIZE = 40'000'000;
+    struct Stats {
+        int playouts;
+        int collisions;
+        int wasted;
+        int nodes;
+        TTable::Stats tt;
+    };
 
     UCTSearch(GameState & g);
     int think(int color, passflag_t passflag = NORMAL);
     void set_playout_limit(int playouts);
+    void set_threads(int threads);
+    void set_max_memory(int max_memory);
+    void set_recording(bool flag);
+    void set_tree_reuse(bool flag);
     void set_analyzing(bool flag);
     void set_quiet(bool flag);
-    void ponder();
+    void ponder(int analysis_interval = 0);
+    bool save_tree(const std::string & filename);
+    bool load_tree(const std::string & filename);
     bool is_running() const;
     bool playout_limit_reached() const;
     void increment_playouts();
+    void increment_wasted();
+    Stats get_stats();
     SearchResult play_simulation(GameState & currstate, UCTNode * const node);
 
 private:
     void dump_stats(KoState & state, UCTNode & parent);
-    std::string get_pv(KoState & state, UCTNode & parent);
     void dump_analysis(int playouts);
+    std::string get_best_line(UCTNode & parent, int color);
+    void output_analysis();
     int get_best_move(passflag_t passflag);
+    std::tuple<int, int, int> get_root_leaders() const;
+    int est_playouts_left(int elapsed_centis, int time_for_move) const;
+    bool should_prune_tree() const;
+    void prune_tree(Utils::ThreadGroup & tg);
+    uint64 get_root_hash() const;
+    static uint64 get_position_hash(GameState & state);
+    bool tree_matches_root() const;
+    bool advance_tree();
+    void clear_tree();
 
     GameState & m_rootstate;
     UCTNode m_root{FastBoard::PASS, 0.0f};
+    // Shared by the threads of this search only
+    TTable m_ttable;
+    TTable::Stats m_ttstart;
+    // Position the tree was built for
+    uint64 m_treehash{0};
+    float m_treekomi{0.0f};
     std::atomic<int> m_nodes{0};
+    // Tree size after the last pruning
+    int m_pruned_nodes{0};
     std::atomic<int> m_playouts{0};
+    // Leaves found in expansion by another thread, and descents
+    // that ended without a result.
+    std::atomic<int> m_collisions{0};
+    std::atomic<int> m_wasted{0};
     std::atomic<bool> m_run{false};
     int m_maxplayouts;
+    int m_maxnodes;
+    int m_threads;
+    bool m_recording{true};
+    bool m_tree_reuse{false};
 };
 
 class UCTWorker {
@@ -25,10 +25,15 @@
 #include <stdarg.h>
 #include <thread>
 #include <mutex>
+#include <stdexcept>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include "Utils.h"
@@ -164,9 +169,97 @@ void Utils::gtp_fail_printf(int id, const char *fmt, ...) {
     }
 }
 
+/*
+    One line of a response that is written out while the command
+    is still running.
+*/
+void Utils::gtp_line_printf(const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stdout, fmt, ap);
+    va_end(ap);
+    printf("\n");
+
+    if (cfg_logfile_handle) {
+        std::lock_guard<std::mutex> lock(IOmutex);
+        va_start(ap, fmt);
+        vfprintf(cfg_logfile_handle, fmt, ap);
+        va_end(ap);
+        fprintf(cfg_logfile_handle, "\n");
+    }
+}
+
 void Utils::log_input(std::string input) {
     if (cfg_logfile_handle) {
         std::lock_guard<std::mutex> lock(IOmutex);
         fprintf(cfg_logfile_handle, ">>%s\n", input.c_str());
     }
 }
+
+#ifdef _WIN32
+Utils::MappedFile::MappedFile(const std::string& filename) {
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                         NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Error opening file");
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_file, &size);
+    m_size = static_cast<size_t>(size.QuadPart);
+    // Empty files can't be mapped
+    if (m_size == 0) {
+        return;
+    }
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping) {
+        m_data = static_cast<const char*>(
+            MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!m_data) {
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+        throw std::runtime_error("Error mapping file");
+    }
+}
+
+Utils::MappedFile::~MappedFile() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+    }
+    CloseHandle(m_file);
+}
+#else
+Utils::MappedFile::MappedFile(const std::string& filename) {
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("Error opening file");
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    // Empty files can't be mapped
+    if (m_size > 0) {
+        auto addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Error mapping file");
+        }
+        m_data = static_cast<const char*>(addr);
+    }
+    // The mapping stays valid without the descriptor.
+    close(fd);
+}
+
+Utils::MappedFile::~MappedFile() {
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+#endif
@@ -30,6 +30,7 @@ namespace Utils {
     void myprintf(const char *fmt, ...);
     void gtp_printf(int id, const char *fmt, ...);
     void gtp_fail_printf(int id, const char *fmt, ...);
+    void gtp_line_printf(const char *fmt, ...);
     void log_input(std::string input);
     bool input_pending();
 
@@ -47,6 +48,27 @@ namespace Utils {
     inline bool is7bit(int c) {
         return c >= 0 && c <= 127;
     }
+
+    /*
+        Read only memory mapping of a whole file.
+        Throws if the file can't be opened.
+    */
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+    private:
+        const char* m_data{nullptr};
+        size_t m_size{0};
+#ifdef _WIN32
+        void* m_file{nullptr};
+        void* m_mapping{nullptr};
+#endif
+    };
 }
 
 #endif
@@ -37,9 +37,11 @@
 //#define USE_MKL
 #define USE_OPENCL
 //#define USE_TUNER
+/* Count spinlock contention per LOCK() site, see the lockstats command */
+//#define USE_LOCK_STATS
 
 #define PROGRAM_NAME "Leela Zero"
-#define PROGRAM_VERSION "0.6"
+#define PROGRAM_VERSION "0.7"
 
 // OpenBLAS limitation
 #if defined(USE_BLAS) && defined(USE_OPENBLAS)
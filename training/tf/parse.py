@@ -16,12 +16,15 @@
 #    You should have received a copy of the GNU General Public License
 #    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
 
+import os
 import sys
 import glob
 import gzip
 import random
 import math
+import ctypes
 import multiprocessing as mp
+import numpy as np
 import tensorflow as tf
 from tfprocess import TFProcess
 
@@ -138,6 +141,50 @@ class ChunkParser:
         while True:
             yield self.queue.get()
 
+class NativeChunkParser:
+    """
+        Batches from libleelaz_data (see src/ChunkLoaderAPI.h), which
+        decodes, shuffles and applies symmetries in C++ threads.
+    """
+    def __init__(self, lib, chunks, batch_size, shuffle_size=65536):
+        threads = max(1, mp.cpu_count() - 1)
+        print("Using {} native loader threads.".format(threads))
+        self.lib = lib
+        self.batch_size = batch_size
+        lib.lz_chunkloader_new.restype = ctypes.c_void_p
+        lib.lz_chunkloader_next_batch.argtypes = [ctypes.c_void_p] + \
+            [np.ctypeslib.ndpointer(np.float32, flags='C_CONTIGUOUS')] * 3
+        lib.lz_chunkloader_free.argtypes = [ctypes.c_void_p]
+        names = (ctypes.c_char_p * len(chunks))(
+            *[chunk.encode() for chunk in chunks])
+        self.loader = lib.lz_chunkloader_new(names, len(chunks), batch_size,
+                                             threads, shuffle_size)
+        if not self.loader:
+            raise RuntimeError("Could not start the native chunk loader")
+
+    def parse_batch(self):
+        while True:
+            planes = np.empty((self.batch_size, 18, 19 * 19), np.float32)
+            probs = np.empty((self.batch_size, 362), np.float32)
+            winner = np.empty((self.batch_size, 1), np.float32)
+            if self.lib.lz_chunkloader_next_batch(self.loader,
+                                                  planes, probs, winner):
+                raise RuntimeError("No usable training data")
+            yield planes, probs, winner
+
+def load_native_loader():
+    """
+        libleelaz_data from $LEELAZ_DATA_LIB or src/, built with
+        'make data'. Returns None if there is none.
+    """
+    path = os.environ.get("LEELAZ_DATA_LIB",
+        os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                     "..", "..", "src", "libleelaz_data.so"))
+    try:
+        return ctypes.CDLL(path)
+    except OSError:
+        return None
+
 def get_chunks(data_prefix):
     return glob.glob(data_prefix + "*.gz")
 
@@ -150,12 +197,19 @@ def main(args):
     if not chunks:
         return
 
-    parser = ChunkParser(chunks)
-
-    dataset = tf.data.Dataset.from_generator(
-        parser.parse_chunk, output_types=(tf.float32, tf.float32, tf.float32))
-    dataset = dataset.shuffle(65536)
-    dataset = dataset.batch(BATCH_SIZE)
+    lib = load_native_loader()
+    if lib:
+        parser = NativeChunkParser(lib, chunks, BATCH_SIZE)
+        dataset = tf.data.Dataset.from_generator(
+            parser.parse_batch,
+            output_types=(tf.float32, tf.float32, tf.float32))
+    else:
+        parser = ChunkParser(chunks)
+        dataset = tf.data.Dataset.from_generator(
+            parser.parse_chunk,
+            output_types=(tf.float32, tf.float32, tf.float32))
+        dataset = dataset.shuffle(65536)
+        dataset = dataset.batch(BATCH_SIZE)
     dataset = dataset.prefetch(16)
     iterator = dataset.make_one_shot_iterator()
     next_batch = iterator.get_next()